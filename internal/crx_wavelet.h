@@ -0,0 +1,46 @@
+/* -*- C++ -*-
+ * File: crx_wavelet.h
+ * Copyright (C) 2018-2019 Alexey Danilchenko
+ * Copyright (C) 2019 Alex Tutubalin, LibRaw LLC
+ *
+   Canon CR3 decoder: wavelet transform state shared by
+   src/decoders/crx.cpp and its tests
+
+LibRaw is free software; you can redistribute it and/or modify
+it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+#pragma once
+
+#include <stdint.h>
+
+struct CrxWaveletTransform
+{
+  int32_t *subband0Buf;
+  int32_t *subband1Buf;
+  int32_t *subband2Buf;
+  int32_t *subband3Buf;
+  int32_t *lineBuf[8];
+  int16_t curLine;
+  int16_t curH;
+  int8_t fltTapH;
+  int16_t height;
+  int16_t width;
+};
+
+enum TileFlags
+{
+  E_HAS_TILES_ON_THE_RIGHT = 1,
+  E_HAS_TILES_ON_THE_LEFT = 2,
+  E_HAS_TILES_ON_THE_BOTTOM = 4,
+  E_HAS_TILES_ON_THE_TOP = 8
+};
+
+// Horizontal inverse 5/3 lifting of the L (subbands 0/1) and H (2/3) lines
+void crxHorizontal53(int32_t *lineBufLA, int32_t *lineBufLB, CrxWaveletTransform *wavelet, uint32_t tileFlag);
@@ -157,6 +157,8 @@ it under the terms of the one of two licenses as you choose:
 	int         ljpeg_diff (ushort *huff);
 	ushort *    ljpeg_row (int jrow, struct jhead *jh);
 	ushort *    ljpeg_row_unrolled (int jrow, struct jhead *jh);
+	void        ljpeg_rows_start(struct jhead *jh, INT64 start, INT64 size);
+	int         ljpeg_rows_failed(struct jhead *jh);
 	void	    ljpeg_idct (struct jhead *jh);
 	unsigned    ph1_bithuff (int nbits, ushort *huff);
 
@@ -169,11 +171,13 @@ it under the terms of the one of two licenses as you choose:
 // Adobe DNG
 	void        adobe_copy_pixel (unsigned int row, unsigned int col, ushort **rp);
 	void        lossless_dng_load_raw();
+	int         lossless_dng_load_tiles();
 	void        deflate_dng_load_raw();
 	void        packed_dng_load_raw();
     void        packed_tiled_dng_load_raw();
     void        uncompressed_fp_dng_load_raw();
 	void        lossy_dng_load_raw();
+	int         lossy_dng_load_tiles(ushort (*curves)[256]);
 //void        adobe_dng_load_raw_nc();
 
 // Pentax
@@ -214,6 +218,7 @@ it under the terms of the one of two licenses as you choose:
 //int         bayer (unsigned row, unsigned col);
 	int         p1raw(unsigned,unsigned);
 	void        phase_one_flat_field (int is_float, int nc);
+	void        phase_one_apply_curve(unsigned row0, unsigned row1, unsigned col0, unsigned col1);
 	int 	    p1rawc(unsigned row, unsigned col, unsigned& count);
 	void 	    phase_one_fix_col_pixel_avg(unsigned row, unsigned col);
 	void 	    phase_one_fix_pixel_grad(unsigned row, unsigned col);
@@ -362,6 +367,10 @@ it under the terms of the one of two licenses as you choose:
 	void        tiff_set(struct tiff_hdr *th, ushort *ntag,ushort tag, ushort type, int count, int val);
 	void        tiff_head (struct tiff_hdr *th, int full);
 
+// banded VNG
+	void vng_interpolate_row(int *(*code)[16], int prow, int pcol, int row, ushort (*dst)[4]);
+	void vng_interpolate_band(int *(*code)[16], int prow, int pcol, int top, int bottom, ushort (*brow)[4], ushort (*held)[4]);
+
 // split AHD code
 	void ahd_interpolate_green_h_and_v(int top, int left, ushort (*out_rgb)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE][3]);
 	void ahd_interpolate_r_and_b_in_rgb_and_convert_to_cielab(int top, int left, ushort (*inout_rgb)[LIBRAW_AHD_TILE][3], short (*out_lab)[LIBRAW_AHD_TILE][3]);
@@ -380,8 +389,10 @@ it under the terms of the one of two licenses as you choose:
 	void parse_fuji_compressed_header();
 	void crxLoadRaw();
 	int  crxParseImageHeader(uchar *cmp1TagData, int nTrack, INT64 size);
+	void crxSetupDownscale();
 	void panasonicC6_load_raw();
 	void panasonicC7_load_raw();
+	void panasonicC67_load_raw(int c7);
 	void panasonicC8_load_raw();
 
 	void nikon_14bit_load_raw();
@@ -390,17 +401,17 @@ it under the terms of the one of two licenses as you choose:
 	void  	dcb_pp();
 	void  	dcb_copy_to_buffer(float (*image2)[3]);
 	void  	dcb_restore_from_buffer(float (*image2)[3]);
-	void  	dcb_color();
-	void  	dcb_color_full();
+	void  	dcb_color(int serial);
+	void  	dcb_color_full(int serial);
 	void  	dcb_map();
 	void  	dcb_correction();
 	void  	dcb_correction2();
 	void  	dcb_refinement();
 	void  	rgb_to_lch(double (*image3)[3]);
 	void  	lch_to_rgb(double (*image3)[3]);
-	void  	fbdd_correction();
+	void  	fbdd_correction(int serial);
 	void  	fbdd_correction2(double (*image3)[3]);
-	void  	fbdd_green();
+	void  	fbdd_green(int serial);
 	void  	dcb_ver(float (*image3)[3]);
 	void 	dcb_hor(float (*image2)[3]);
 	void 	dcb_color2(float (*image2)[3]);
@@ -20,7 +20,7 @@ it under the terms of the one of two licenses as you choose:
 #pragma  once
 #include <stdint.h>
 #include <vector>
-#include "libraw_cxx_defs.h"
+#include "../libraw/libraw_const.h"
 
 struct BitPump // generic bit source
 {
@@ -132,6 +132,65 @@ struct BitPumpJpeg : public BitPump
 };
 
 
+/* Non-virtual bit reader for the row decoder below. Stops at the first
+   marker (0xff followed by non-zero) like dcraw's getbithuff(): zero bits
+   are fed after it and counted in zbits, so underrun is (nbits < zbits) */
+struct BitPumpLjpeg
+{
+  const uint8_t *buffer;
+  unsigned size, pos;
+  uint64_t bits;
+  uint32_t nbits, zbits;
+  bool marker;
+
+  BitPumpLjpeg(const uint8_t *b, unsigned s, unsigned p)
+      : buffer(b), size(s), pos(p), bits(0), nbits(0), zbits(0), marker(false) {}
+
+  void fill()
+  {
+    while (nbits <= 56)
+    {
+      uint8_t c = 0;
+      if (!marker && pos < size)
+      {
+        c = buffer[pos];
+        if (c != 0xff)
+          pos++;
+        else if (pos + 1 < size && buffer[pos + 1] == 0)
+          pos += 2;
+        else
+          marker = true;
+      }
+      else
+        marker = true;
+      if (marker)
+      {
+        c = 0;
+        zbits += 8;
+      }
+      bits = (bits << 8) | c;
+      nbits += 8;
+    }
+  }
+  uint32_t peek(uint32_t num)
+  {
+    if (!num)
+      return 0;
+    if (num > nbits)
+      fill();
+    return uint32_t(bits >> (nbits - num)) & ((1u << num) - 1u);
+  }
+  void consume(uint32_t num) { nbits -= num; }
+  uint32_t get(uint32_t num)
+  {
+    uint32_t val = peek(num);
+    consume(num);
+    return val;
+  }
+  bool underrun() const { return nbits < zbits; }
+  void restart(); /* skip to the data after next RSTn marker */
+};
+
 const uint32_t LIBRAW_DECODE_CACHE_BITS = 13;
 const uint64_t LIBRAW_CACHE_PRESENT_FLAG = 0x100000000L;
 
@@ -247,10 +306,12 @@ struct LibRaw_LjpegDecompressor
 	LibRaw_SOFInfo sof;
 	uint32_t predictor, point_transform;
 	uint32_t datastart;
+	uint32_t restart_interval; // from DRI, 0x7fffffff if not set
 	std::vector<HuffTable> dhts;
 	LibRaw_LjpegDecompressor(uint8_t *b, unsigned s);
-	LibRaw_LjpegDecompressor(uint8_t *b, unsigned bs, bool dngbug, bool csfix);
-	void  initialize(bool dngbug, bool csfix);
+	// minprecision: lowest SOF3 sample precision accepted
+	LibRaw_LjpegDecompressor(uint8_t *b, unsigned bs, bool dngbug, bool csfix, uint32_t minprecision = 12);
+	void  initialize(bool dngbug, bool csfix, uint32_t minprecision);
     uint8_t next_marker(bool allowskip);
 	bool  parse_dht(bool init[4], uint32_t dht_bits[4][17], uint32_t dht_huffval[4][256]); // return true on OK;
 	bool decode_ljpeg_422(std::vector<uint16_t> &dest, int width, int height);
@@ -279,9 +340,58 @@ struct LibRaw_LjpegDecompressor
 			EOI = 0xd9,  // end of image
 			SOS = 0xda,  // start of scan
 			DQT = 0xdb,  // quantization tables
+			DRI = 0xdd,  // restart interval
 			Fill = 0xff,
 		};
 	};
 	enum State::States state;
 };
 
+/* Generic lossless JPEG (SOF3) row decoder with dcraw's ljpeg_row()
+   prediction rules, huffman table selection, Canon sRAW subsampling and
+   DNG 1.0 16-bit diff handling. All bit reader state is held in the object,
+   so separate instances may decode separate streams in parallel. */
+struct LibRaw_LjpegRowDecoder
+{
+  LibRaw_LjpegRowDecoder(LibRaw_LjpegDecompressor &d, bool dngbug);
+  bool valid() const { return ok; }
+  uint16_t *next_row(); // wide * clrs samples, NULL if not valid()
+  /* decode only the first w MCUs of each row (Canon sRAW, see
+     canon_sraw_load_raw()); false if called after next_row() or w > wide */
+  bool narrow(unsigned w);
+  unsigned wide, high, clrs, sraw, bits, psv; // geometry, read only
+  unsigned errors;      // out of range samples, bit reader underruns, rows past high
+  unsigned consumed() const { return pump.pos; } // stream bytes fetched so far
+
+private:
+  LibRaw_LjpegDecompressor &dec;
+  BitPumpLjpeg pump;
+  HuffTable *huff[6];
+  std::vector<uint16_t> rows;
+  int32_t vpred[6];
+  unsigned row;
+  bool dng_bug, ok;
+  int32_t diff(HuffTable &h);
+  void decode_sraw(uint16_t *cur, const uint16_t *prev);
+};
+
+class LibRaw_abstract_datastream;
+
+/* Row decoder on a datastream region: points into memory based streams
+   (data_at()), reads a private copy for the others. The part of a mapped
+   region actually decoded is added to the stream's bytes_read() on
+   destruction. */
+struct LibRaw_LjpegStream
+{
+  LibRaw_LjpegStream(LibRaw_abstract_datastream *stream, int64_t offset, unsigned size, bool dngbug);
+  ~LibRaw_LjpegStream();
+  std::vector<uint8_t> storage;
+  uint8_t *data;
+  unsigned size;
+  LibRaw_LjpegDecompressor dec;
+  LibRaw_LjpegRowDecoder rows;
+private:
+  LibRaw_abstract_datastream *source;
+  static uint8_t *map(LibRaw_abstract_datastream *stream, int64_t offset, unsigned size,
+                      std::vector<uint8_t> &storage);
+};
@@ -137,6 +137,12 @@ extern "C"
                                            void *datap);
   DllDef void libraw_set_progress_handler(libraw_data_t *, progress_callback cb,
                                           void *datap);
+  DllDef void libraw_set_allocator(libraw_data_t *,
+                                   const libraw_allocator_t *allocator);
+  DllDef void libraw_set_arena_mode(libraw_data_t *, int enable);
+  DllDef void libraw_set_perf_stats(libraw_data_t *, int enable);
+  DllDef const libraw_perf_stats_t *libraw_get_perf_stats(libraw_data_t *);
+  DllDef void libraw_reset_perf_stats(libraw_data_t *);
   DllDef const char *libraw_unpack_function_name(libraw_data_t *lr);
   DllDef int libraw_get_decoder_info(libraw_data_t *lr,
                                      libraw_decoder_info_t *d);
@@ -152,6 +158,9 @@ extern "C"
   DllDef int libraw_dcraw_process(libraw_data_t *lr);
   DllDef libraw_processed_image_t *
   libraw_dcraw_make_mem_image(libraw_data_t *lr, int *errc);
+  DllDef int libraw_dcraw_stream_mem_image(libraw_data_t *lr,
+                                           mem_image_rows_callback cb,
+                                           void *data, int rows_per_call);
   DllDef libraw_processed_image_t *
   libraw_dcraw_make_mem_thumb(libraw_data_t *lr, int *errc);
   DllDef void libraw_dcraw_clear_mem(libraw_processed_image_t *);
@@ -293,6 +302,8 @@ public:
   void get_mem_image_format(int *width, int *height, int *colors,
                             int *bps) const;
   int copy_mem_image(void *scan0, int stride, int bgr);
+  int dcraw_stream_mem_image(mem_image_rows_callback cb, void *data,
+                             int rows_per_call = 0);
 
   /* free all internal data structures */
   void recycle();
@@ -349,7 +360,22 @@ public:
 
   void set_dng_host(void *);
 
+  /* Memory: allocator for all internal buffers (NULL: C runtime heap),
+     recycles the instance. Arena mode keeps large buffers between files
+     to reuse them for the next file of the same or smaller size */
+  void set_allocator(const libraw_allocator_t *allocator);
+  void set_arena_mode(int enable);
+
+  /* Per-stage profiling, off by default. Counters are accumulated over all
+     processed files until reset_perf_stats() */
+  void set_perf_stats(int enable) { perf_enabled = enable; }
+  const libraw_perf_stats_t *get_perf_stats() { return &perf_stats; }
+  void reset_perf_stats();
+
 protected:
+  void mem_image_gamma();
+  void copy_mem_image_rows(void *scan0, int stride, int bgr, int row0,
+                           int nrows);
   static void *memmem(char *haystack, size_t haystacklen, char *needle,
                       size_t needlelen);
   static char *strcasestr(char *h, const char *n);
@@ -370,9 +396,15 @@ protected:
   virtual void copy_fuji_uncropped(unsigned short cblack[4],
                                    unsigned short *dmaxp);
   virtual void copy_bayer(unsigned short cblack[4], unsigned short *dmaxp);
+  virtual void copy_bayer_scaled(unsigned short cblack[4], float scale_mul[4],
+                                 unsigned short *dmaxp);
+  void bayer_black_maximum(unsigned short cblack[4], unsigned short *dmaxp);
+  int raw2image_ex_internal(int do_subtract_black, int *do_scale_colors);
   virtual void fuji_rotate();
   virtual void convert_to_rgb_loop(float out_cam[3][4]);
+  void convert_to_rgb_rows(float out_cam[3][4], ushort *dst, int dst_step);
   virtual void lin_interpolate_loop(int *code, int size);
+  virtual void vng_interpolate_loop(int *(*code)[16], int prow, int pcol);
   virtual void scale_colors_loop(float scale_mul[4]);
 
   /* Fujifilm compressed decoder public interface (to make parallel decoder) */
@@ -384,8 +416,25 @@ protected:
   /* CR3 decoder public interface to make parallel decoder */
   virtual void crxLoadDecodeLoop(void *, int);
   int crxDecodePlane(void *, uint32_t planeNumber);
+  int crxDecodeTile(void *, int tileNumber, uint32_t planeNumber);
   virtual void crxLoadFinalizeLoopE3(void *, int);
   void crxConvertPlaneLineDf(void *, int);
+  /* Sony ARW2 parallel decoder: decodes nrows rows of raw_width bytes */
+  virtual void sony_arw2_decode_loop(uchar *data, int row0, int nrows);
+  void sony_arw2_decode_row(uchar *data, int row);
+  /* Panasonic RW2 parallel decoders: pana_encoding 5 pages, C6/C7 rows */
+  virtual void panasonic_decode_loop(uchar *pages, int npages, INT64 block0,
+                                     INT64 nblocks);
+  void panasonic_decode_block(const uchar *bytes, INT64 block);
+  virtual void panasonicC67_decode_loop(uchar *data, int rowbytes, int row0,
+                                        int nrows, int c7);
+  void panasonicC6_decode_row(uchar *data, ushort *rowptr);
+  void panasonicC7_decode_row(uchar *data, ushort *rowptr);
+  /* Phase One compressed parallel decoder: rows at their own offsets */
+  virtual void phase_one_decode_loop(const int *offset, int row0, int nrows,
+                                     struct phase_one_row_state *st);
+  void phase_one_decode_row(INT64 start, int row, uchar *buf,
+                            struct phase_one_row_state &st);
   /* Panasonic Compression 8 parallel decoder stubs*/
   virtual void pana8_decode_loop(void*);
   int pana8_decode_strip(void*, int); // return: 0 if OK, non-zero on error
@@ -422,6 +471,19 @@ protected:
   libraw_memmgr memmgr;
   libraw_callbacks_t callbacks;
 
+  /* perf stats: perf_mark is the snapshot taken when the current stage began */
+  void perf_snapshot(libraw_perf_stage_t &s);
+  void perf_stage_begin()
+  {
+    if (perf_enabled)
+      perf_snapshot(perf_mark);
+  }
+  void perf_stage_end(unsigned stage);
+  int perf_enabled;
+  libraw_perf_stats_t perf_stats;
+  libraw_perf_stage_t perf_mark;
+  void *perf_stream;
+
   //void (LibRaw::*write_thumb)();
   void (LibRaw::*write_fun)();
   void (LibRaw::*load_raw)();
@@ -462,6 +524,9 @@ protected:
   void hat_transform(float *temp, float *base, int st, int size, int sc);
   void wavelet_denoise();
   void scale_colors();
+  int scale_colors_auto_wb();
+  void scale_colors_mul(float scale_mul[4]);
+  void scale_colors_aber();
   void median_filter();
   void blend_highlights();
   void recover_highlights();
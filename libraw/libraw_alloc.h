@@ -22,130 +22,42 @@ it under the terms of the one of two licenses as you choose:
 #include <stdlib.h>
 #include <string.h>
 #include "libraw_const.h"
+#include "libraw_types.h"
 
 #ifdef __cplusplus
 
 #define LIBRAW_MSIZE 512
 
+struct libraw_allocator_t;
+
+/* Tracks all blocks allocated through it, so cleanup() releases
+   everything left after an exception or on recycle(). Blocks are kept in
+   pointer-hashed shards, each with its own lock under OpenMP, so tracking
+   is O(1) and threads of a parallel decoder rarely wait on each other.
+   Blocks come from the C runtime heap or from a user allocator.
+   In reuse (arena) mode large freed blocks are kept and handed out again
+   for requests of similar size instead of being returned to the heap.
+   Implementation is in src/utils/utils_libraw.cpp */
 class DllDef libraw_memmgr
 {
 public:
-  libraw_memmgr(unsigned ee) : extra_bytes(ee)
-  {
-    size_t alloc_sz = LIBRAW_MSIZE * sizeof(void *);
-    mems = (void **)::malloc(alloc_sz);
-	if(mems)
-		memset(mems, 0, alloc_sz);
-  }
-  ~libraw_memmgr()
-  {
-    cleanup();
-	if(mems)
-		::free(mems);
-  }
-  void *malloc(size_t sz)
-  {
-#ifdef LIBRAW_USE_CALLOC_INSTEAD_OF_MALLOC
-    void *ptr = ::calloc(sz + extra_bytes, 1);
-#else
-    void *ptr = ::malloc(sz + extra_bytes);
-#endif
-    mem_ptr(ptr);
-    return ptr;
-  }
-  void *calloc(size_t n, size_t sz)
-  {
-    void *ptr = ::calloc(n + (extra_bytes + sz - 1) / (sz ? sz : 1), sz);
-    mem_ptr(ptr);
-    return ptr;
-  }
-  void *realloc(void *ptr, size_t newsz)
-  {
-    void *ret = ::realloc(ptr, newsz + extra_bytes);
-    forget_ptr(ptr);
-    mem_ptr(ret);
-    return ret;
-  }
-  void free(void *ptr)
-  {
-    forget_ptr(ptr);
-    ::free(ptr);
-  }
-  void cleanup(void)
-  {
-	if (!mems) return;
-    for (int i = 0; i < LIBRAW_MSIZE; i++)
-      if (mems[i])
-      {
-        ::free(mems[i]);
-        mems[i] = NULL;
-      }
-  }
+  libraw_memmgr(unsigned ee);
+  ~libraw_memmgr();
+  void *malloc(size_t sz);
+  void *calloc(size_t n, size_t sz);
+  void *realloc(void *ptr, size_t newsz);
+  void free(void *ptr);
+  void cleanup(void);
+  /* NULL: C runtime heap. Should be changed only when no blocks are allocated */
+  void set_allocator(const libraw_allocator_t *allocator);
+  void set_reuse(int enable);
+  int get_reuse();
+  /* cumulative size of malloc/calloc/realloc requests, for perf stats */
+  INT64 bytes_requested();
 
 private:
-  void **mems;
+  void *tracker; /* struct libraw_memmgr_tracker */
   unsigned extra_bytes;
-  void mem_ptr(void *ptr)
-  {
-	  if (!mems) return;
-#if defined(LIBRAW_USE_OPENMP)
-      bool ok = false; /* do not return from critical section */
-#endif
-
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp critical
-      {
-#endif
-          if (ptr)
-          {
-              for (int i = 0; i < LIBRAW_MSIZE - 1; i++)
-                  if (!mems[i])
-                  {
-                      mems[i] = ptr;
-#if defined(LIBRAW_USE_OPENMP)
-		      ok = true;
-		      break;
-#else
-                      return;
-#endif
-                  }
-#ifdef LIBRAW_MEMPOOL_CHECK
-#if !defined(LIBRAW_USE_OPENMP)
-              /* remember ptr in last mems item to be free'ed at cleanup */
-              if (!mems[LIBRAW_MSIZE - 1])
-                  mems[LIBRAW_MSIZE - 1] = ptr;
-              throw LIBRAW_EXCEPTION_MEMPOOL;
-#endif
-#endif
-          }
-#if defined(LIBRAW_USE_OPENMP)
-      }
-      if(!ok)
-      {
-          if (!mems[LIBRAW_MSIZE - 1])
-              mems[LIBRAW_MSIZE - 1] = ptr;
-          throw LIBRAW_EXCEPTION_MEMPOOL;
-      }
-#endif
-  }
-  void forget_ptr(void *ptr)
-  {
-	if (!mems) return;
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp critical
-    {
-#endif
-     if (ptr)
-      for (int i = 0; i < LIBRAW_MSIZE; i++)
-        if (mems[i] == ptr)
-        {
-          mems[i] = NULL;
-          break;
-        }
-#if defined(LIBRAW_USE_OPENMP)
-    }
-#endif
-  }
 };
 
 #endif /* C++ */
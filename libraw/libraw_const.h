@@ -50,6 +50,11 @@ it under the terms of the one of two licenses as you choose:
 #define LIBRAW_MAX_THUMBNAIL_MB 512L
 #endif
 
+/* default number of scanlines per dcraw_stream_mem_image() callback call */
+#ifndef LIBRAW_MEM_IMAGE_STREAM_ROWS
+#define LIBRAW_MEM_IMAGE_STREAM_ROWS 16
+#endif
+
 /* Check if enough file space exists before tag read */
 #ifndef LIBRAW_NO_IOSPACE_CHECK
 #define LIBRAW_IOSPACE_CHECK
@@ -72,11 +77,10 @@ it under the terms of the one of two licenses as you choose:
 #endif
 #endif
 
-/* LibRaw uses own memory pool management, with LIBRAW_MSIZE (512)
-entries. It is enough for parsing/decoding non-damaged files, but
-may overflow on specially crafted files (eg. with many string values
-like XMP blocks.
-LIBRAW_MEMPOOL_CHECK define will result in error on pool overflow */
+/* LibRaw tracks its own allocations (libraw_memmgr) to free them on
+recycle() or after an error. The tracker is not size limited anymore:
+LIBRAW_MEMPOOL_CHECK and LIBRAW_MSIZE are kept for source compatibility,
+LIBRAW_EXCEPTION_MEMPOOL is only thrown if the tracker itself can't grow */
 #ifndef LIBRAW_NO_MEMPOOL_CHECK
 #define LIBRAW_MEMPOOL_CHECK
 #endif
@@ -691,7 +695,8 @@ enum LibRaw_processing_options
   LIBRAW_RAWOPTIONS_CANON_IGNORE_MAKERNOTES_ROTATION = 1 << 23,
   LIBRAW_RAWOPTIONS_ALLOW_JPEGXL_PREVIEWS = 1 << 24,
   LIBRAW_RAWOPTIONS_CANON_CHECK_CAMERA_AUTO_ROTATION_MODE = 1 << 26,
-  LIBRAW_RAWOPTIONS_DNG_STAGE23_IFPRESENT_JPGJXL = 1 << 27
+  LIBRAW_RAWOPTIONS_DNG_STAGE23_IFPRESENT_JPGJXL = 1 << 27,
+  LIBRAW_RAWOPTIONS_USE_MMAP = 1 << 28
 };
 
 enum LibRaw_decoder_flags
@@ -807,6 +812,8 @@ enum LibRaw_progress
   LIBRAW_PROGRESS_TRESERVED2 = 1 << 30
 };
 #define LIBRAW_PROGRESS_THUMB_MASK 0x0fffffff
+/* number of per-stage slots in libraw_perf_stats_t: one per progress bit */
+#define LIBRAW_PERF_STAGES 32
 
 enum LibRaw_errors
 {
@@ -64,6 +64,13 @@ it under the terms of the one of two licenses as you choose:
 #define WIN32SECURECALLS
 #endif
 
+/* Linux: open_file() maps the whole file into memory (zero-copy reads) if
+   LIBRAW_RAWOPTIONS_USE_MMAP is set. Off by default: a file truncated
+   while mapped raises SIGBUS on access */
+#if defined(__linux__) && !defined(LIBRAW_NO_MMAP_DATASTREAM)
+#define LIBRAW_USE_MMAP_DATASTREAM
+#endif
+
 #ifdef USE_DNGSDK
 
 #if defined LIBRAW_WIN32_CALLS
@@ -95,7 +102,7 @@ class LibRaw_bit_buffer;
 class DllDef LibRaw_abstract_datastream
 {
 public:
-  LibRaw_abstract_datastream() { };
+  LibRaw_abstract_datastream() : _bytes_read(0) { };
   virtual ~LibRaw_abstract_datastream(void) { }
   virtual int valid() = 0;
   virtual int read(void *, size_t, size_t) = 0;
@@ -118,6 +125,22 @@ public:
 #ifdef LIBRAW_WIN32_UNICODEPATHS
   virtual const wchar_t *wfname() { return NULL; };
 #endif
+  /* positional read: reads up to size bytes at offset without moving the
+     stream position, returns bytes read. Safe to call from parallel
+     decoders; default implementation is serialized via lock()/seek()/read() */
+  virtual INT64 readAt(void *ptr, size_t size, INT64 offset);
+  /* direct pointer to len bytes at offset for memory-backed streams,
+     NULL if the stream is not memory-backed or range is out of bounds.
+     Mapping is not counted in bytes_read(): the caller reports the bytes
+     it actually consumed with count_read() */
+  virtual const unsigned char *data_at(INT64, size_t) { return NULL; }
+  /* bytes fetched by read()/readAt() of the built-in streams and consumed
+     through data_at() so far; single-byte get_char() reads are not counted */
+  INT64 bytes_read() const { return _bytes_read; }
+  void count_read(INT64 bytes);
+
+protected:
+  INT64 _bytes_read;
 };
 
 #ifndef LIBRAW_NO_IOSTREAMS_DATASTREAM
@@ -248,8 +271,9 @@ public:
         return r > 0 ? c : r;
     }
 
+    virtual INT64 readAt(void *ptr, size_t size, INT64 off);
+
 protected:
-    INT64   readAt(void *ptr, size_t size, INT64 off);
     bool	fillBufferAt(int buf, INT64 off);
     int		selectStringBuffer(INT64 len, INT64& contains);
     HANDLE fhandle;
@@ -284,6 +308,14 @@ public:
     if (streampos >= streamsize)   return -1;
     return buf[streampos++];
   }
+  virtual INT64 readAt(void *ptr, size_t size, INT64 offset);
+  virtual const unsigned char *data_at(INT64 offset, size_t len)
+  {
+    if (!buf || offset < 0 || size_t(offset) > streamsize ||
+        len > streamsize - size_t(offset))
+      return NULL;
+    return buf + offset;
+  }
 
 private:
   unsigned char *buf;
@@ -309,6 +341,9 @@ public:
   virtual const char *fname();
 #ifdef LIBRAW_WIN32_UNICODEPATHS
   virtual const wchar_t *wfname();
+#endif
+#ifndef LIBRAW_WIN32_CALLS
+  virtual INT64 readAt(void *ptr, size_t size, INT64 offset);
 #endif
   virtual int get_char()
   {
@@ -328,6 +363,29 @@ protected:
 #endif
 };
 
+#ifdef LIBRAW_USE_MMAP_DATASTREAM
+class DllDef LibRaw_mmap_datastream : public LibRaw_buffer_datastream
+{
+public:
+  /* ctor: opens and maps the whole file read-only; valid() is 0 on failure */
+  LibRaw_mmap_datastream(const char *fname);
+  /* dtor: unmap the file */
+  virtual ~LibRaw_mmap_datastream();
+  virtual const char *fname();
+
+protected:
+  inline void reconstruct_base()
+  {
+    (LibRaw_buffer_datastream &)*this =
+        LibRaw_buffer_datastream(pView_, (size_t)cbView_);
+  }
+
+  std::string filename;
+  void *pView_;  /* pointer to the mapped memory */
+  INT64 cbView_; /* size of the mapping in bytes */
+};
+#endif
+
 #ifdef LIBRAW_WIN32_CALLS
 class DllDef LibRaw_windows_datastream : public LibRaw_buffer_datastream
 {
@@ -137,6 +137,8 @@ typedef struct
   int32_t hasTileRows;
   int32_t mdatHdrSize;
   int32_t medianBits;
+  // Not from header: wavelet levels left out for rawparams.cr3_downscale
+  int32_t reduceLevels;
   // Not from header, but from datastream
   uint32_t MediaSize;
   INT64 MediaOffset;
@@ -247,12 +249,14 @@ struct tiff_ifd_t
   libraw_dng_color_t dng_color[2];
   libraw_dng_levels_t dng_levels;
   int newsubfiletype;
+  int bytes_type; /* TIFF type of the TileByteCounts array at bytes */
 };
 
 struct jhead
 {
   int algo, bits, high, wide, clrs, sraw, psv, restart, vpred[6];
   ushort quant[64], idct[64], *huff[20], *free[20], *row;
+  void *rowdec; /* LibRaw_LjpegStream set by ljpeg_rows_start() */
 };
 
 struct libraw_tiff_tag
@@ -320,6 +324,8 @@ struct tiff_hdr
   do                                                                           \
   {                                                                            \
     imgdata.progress_flags |= stage;                                           \
+    if (perf_enabled)                                                          \
+      perf_stage_end(stage);                                                   \
     fprintf(stderr, "SET_FLAG: %d\n", stage);                                  \
   } while (0)
 
@@ -354,6 +360,8 @@ struct tiff_hdr
   do                                                                           \
   {                                                                            \
     imgdata.progress_flags |= stage;                                           \
+    if (perf_enabled)                                                          \
+      perf_stage_end(stage);                                                   \
   } while (0)
 
 #endif
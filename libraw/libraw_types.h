@@ -158,6 +158,40 @@ typedef unsigned long long UINT64;
   typedef int (*pre_identify_callback)(void *ctx);
   typedef void (*post_identify_callback)(void *ctx);
   typedef void (*process_step_callback)(void *ctx);
+  /* Receives nrows output scanlines starting at row, see
+     LibRaw::dcraw_stream_mem_image(). Non-zero return value stops output */
+  typedef int (*mem_image_rows_callback)(void *data, int row, int nrows,
+                                         const void *rows, int stride);
+
+  /* User memory allocator, see LibRaw::set_allocator(). All four functions
+     must be set; data is passed to each call */
+  typedef struct libraw_allocator_t
+  {
+    void *(*malloc_func)(void *data, size_t size);
+    void *(*calloc_func)(void *data, size_t n, size_t size);
+    void *(*realloc_func)(void *data, void *ptr, size_t size);
+    void (*free_func)(void *data, void *ptr);
+    void *data;
+  } libraw_allocator_t;
+
+  /* Per-stage counters collected when LibRaw::set_perf_stats(1) is on.
+     Times are in seconds, byte counts are cumulative for the stage. */
+  typedef struct
+  {
+    double wall_time;
+    double cpu_time;
+    INT64 bytes_read;
+    INT64 bytes_allocated;
+    int threads;
+    int calls;
+  } libraw_perf_stage_t;
+
+  /* stage[n] accumulates the work finished by SET_PROC_FLAG(1 << n),
+     i.e. LIBRAW_PROGRESS_* bit number n */
+  typedef struct
+  {
+    libraw_perf_stage_t stage[LIBRAW_PERF_STAGES];
+  } libraw_perf_stats_t;
 
   typedef struct
   {
@@ -970,6 +1004,8 @@ typedef unsigned long long UINT64;
     int no_auto_scale;
     /* Disable intepolation */
     int no_interpolation;
+    /* Store output as packed RGB in rgb_image instead of image[][4] */
+    int packed_rgb;
   } libraw_output_params_t;
 
   typedef struct  
@@ -988,6 +1024,8 @@ typedef unsigned long long UINT64;
       char p4shot_order[5];
       /* Custom camera list */
       char **custom_camera_strings;
+      /* Canon CR3: decode at 1/2, 1/4 or 1/8 size (1, 2, 3) */
+      unsigned cr3_downscale;
   }libraw_raw_unpack_params_t;
 
   typedef struct
@@ -1128,6 +1166,8 @@ typedef unsigned long long UINT64;
 	libraw_thumbnail_list_t thumbs_list;
     libraw_rawdata_t rawdata;
     void *parent_class;
+    /* Packed RGB output, see params.packed_rgb */
+    ushort (*rgb_image)[3];
   } libraw_data_t;
 
   struct fuji_q_table
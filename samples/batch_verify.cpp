@@ -10,7 +10,9 @@
  *     produces a byte-identical image (catches nondeterminism / data races,
  *     e.g. from the OpenMP postprocessing paths);
  *   - fast: per-file unpack/postprocess timing and Mpix/sec, with slow
- *     outliers flagged, grouped by detected format.
+ *     outliers flagged, grouped by detected format. With -P the per-stage
+ *     counters (LibRaw::set_perf_stats()) of the first decodes are summed
+ *     over all files.
  *
  * Exit code is non-zero if any file fails to open/decode or is
  * non-deterministic, so it can be used in CI.
@@ -152,13 +154,33 @@ struct Result
   std::string error;
 };
 
+// Adds the per-stage counters of one decode to the running totals
+static void add_perf(libraw_perf_stats_t &total, const libraw_perf_stats_t *ps)
+{
+  for (int i = 0; i < LIBRAW_PERF_STAGES; i++)
+  {
+    libraw_perf_stage_t &t = total.stage[i];
+    const libraw_perf_stage_t &st = ps->stage[i];
+    t.wall_time += st.wall_time;
+    t.cpu_time += st.cpu_time;
+    t.bytes_read += st.bytes_read;
+    t.bytes_allocated += st.bytes_allocated;
+    t.threads = std::max(t.threads, st.threads);
+    t.calls += st.calls;
+  }
+}
+
 // Decode one file once; fill checksum/dims. Returns LIBRAW_SUCCESS or error.
+// If perf is set, the per-stage counters of this decode are added to it.
 static int decode_once(const char *file, unsigned long long &checksum,
                        double &unpack_ms, double &process_ms, double &mpix,
-                       std::string &fmt, std::string &camera, int &err)
+                       std::string &fmt, std::string &camera, int &err,
+                       libraw_perf_stats_t *perf = NULL)
 {
   LibRaw R;
   int ret;
+  if (perf)
+    R.set_perf_stats(1);
   if ((ret = R.open_file(file)) != LIBRAW_SUCCESS)
   {
     err = ret;
@@ -195,12 +217,14 @@ static int decode_once(const char *file, unsigned long long &checksum,
   checksum = fnv1a((const unsigned char *)img->data, img->data_size);
   mpix = (img->width * (double)img->height) / 1e6;
   R.dcraw_clear_mem(img);
+  if (perf)
+    add_perf(*perf, R.get_perf_stats());
   return LIBRAW_SUCCESS;
 }
 
 int main(int argc, char **argv)
 {
-  bool recurse = false;
+  bool recurse = false, perf = false;
   double slow_threshold = 0.0; // msec; 0 => auto (3x median)
   std::vector<std::string> roots;
 
@@ -210,6 +234,8 @@ int main(int argc, char **argv)
       recurse = true;
     else if (!strcmp(argv[i], "-t") && i + 1 < argc)
       slow_threshold = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-P"))
+      perf = true;
     else
       roots.push_back(argv[i]);
   }
@@ -220,10 +246,12 @@ int main(int argc, char **argv)
            LibRaw::version(), LibRaw::cameraCount());
     printf("Opens every file in a folder, checks each decodes consistently "
            "(twice, byte-identical) and reports speed.\n");
-    printf("Usage: %s [-r] [-t slow_msec] <folder|file> [...]\n", argv[0]);
+    printf("Usage: %s [-r] [-t slow_msec] [-P] <folder|file> [...]\n",
+           argv[0]);
     printf("  -r          recurse into subdirectories\n");
     printf("  -t <msec>   flag files whose postprocess exceeds this "
            "(default: 3x median)\n");
+    printf("  -P          print per-stage time/read/alloc totals\n");
     return 2;
   }
 
@@ -256,6 +284,8 @@ int main(int argc, char **argv)
 
   std::vector<Result> results;
   int failures = 0, nondet = 0;
+  libraw_perf_stats_t perf_total;
+  memset(&perf_total, 0, sizeof(perf_total));
   for (size_t i = 0; i < files.size(); i++)
   {
     Result r;
@@ -273,7 +303,8 @@ int main(int argc, char **argv)
     int err = 0;
     double u1, p1, mp;
     std::string fmt, cam;
-    int ret = decode_once(r.file.c_str(), c1, u1, p1, mp, fmt, cam, err);
+    int ret = decode_once(r.file.c_str(), c1, u1, p1, mp, fmt, cam, err,
+                          perf ? &perf_total : NULL);
     if (ret != LIBRAW_SUCCESS)
     {
       r.error = libraw_strerror(err);
@@ -348,6 +379,24 @@ int main(int argc, char **argv)
   if (!any_slow)
     printf("  (none; median process time %.0f ms)\n", median);
 
+  if (perf)
+  {
+    printf("\n==== Per-stage totals (first decode of each file) ====\n");
+    printf("  %-28s %6s %10s %10s %9s %9s %4s\n", "Stage", "calls",
+           "wall msec", "CPU msec", "read MB", "alloc MB", "thr");
+    for (int i = 0; i < LIBRAW_PERF_STAGES; i++)
+    {
+      const libraw_perf_stage_t &st = perf_total.stage[i];
+      if (!st.calls)
+        continue;
+      printf("  %-28s %6d %10.1f %10.1f %9.2f %9.2f %4d\n",
+             libraw_strprogress(LibRaw_progress(1 << i)), st.calls,
+             st.wall_time * 1000.0, st.cpu_time * 1000.0,
+             st.bytes_read / 1048576.0, st.bytes_allocated / 1048576.0,
+             st.threads);
+    }
+  }
+
   printf("\n==== Result ====\n");
   printf("  total=%zu  ok=%zu  failed=%d  nondeterministic=%d\n", files.size(),
          files.size() - failures, failures, nondet);
@@ -113,6 +113,7 @@ void usage(const char *prog)
          "-aexpo <e p> exposure correction\n"
          "-apentax4shot enables merge of 4-shot pentax files\n"
          "-apentax4shotorder 3102 sets pentax 4-shot alignment order\n"
+         "-acr3scale N decode Canon CR3 at 1/2, 1/4 or 1/8 size (N=1,2,3)\n"
 #ifdef USE_RAWSPEED_BITS
          "-arsbits V Set use_rawspeed to V\n"
 #endif
@@ -407,6 +408,10 @@ int main(int argc, char *argv[])
       {
         strncpy(OUTR.p4shot_order, argv[arg++], 5);
       }
+      else if (!strcmp(optstr, "-acr3scale"))
+      {
+        OUTR.cr3_downscale = atoi(argv[arg++]);
+      }
       else if (!argv[arg - 1][2])
         OUT.use_auto_wb = 1;
       else
@@ -52,7 +52,7 @@ int main(int argc, char *argv[])
         "postprocessing benchmark: LibRaw %s sample, %d cameras supported\n"
         "Measures postprocessing speed with different options\n"
         "Usage: %s [-a] [-H N] [-q N] [-h] [-m N] [-n N] [-s N] [-B x y w h] "
-        "[-R N]\n"
+        "[-R N] [-P]\n"
         "-a             average image for white balance\n"
         "-H <num>       Highlight mode (0=clip, 1=unclip, 2=blend, "
         "3+=rebuild)\n"
@@ -63,13 +63,15 @@ int main(int argc, char *argv[])
         "-s <num>       Select one raw image from input file\n"
         "-B <x y w h>   Crop output image\n"
         "-R <num>       Number of repetitions\n"
-        "-c             Do not use rawspeed\n",
+        "-c             Do not use rawspeed\n"
+        "-P             Print per-stage timings and I/O, memory counters\n",
         LibRaw::version(), LibRaw::cameraCount(), argv[0]);
     return 0;
   }
   char opm, opt, *cp, *sp;
   int arg, c;
   int shrink = 0;
+  int perf = 0;
 
   argv[argc] = (char *)"";
   for (arg = 1; (((opm = argv[arg][0]) - 2) | 2) == '+';)
@@ -120,6 +122,10 @@ int main(int argc, char *argv[])
     case 'c':
       RawProcessor.imgdata.rawparams.use_rawspeed = 0;
       break;
+    case 'P':
+      perf = 1;
+      RawProcessor.set_perf_stats(1);
+      break;
     default:
       fprintf(stderr, "Unknown option \"-%c\".\n", opt);
       return 1;
@@ -128,6 +134,7 @@ int main(int argc, char *argv[])
   for (; arg < argc; arg++)
   {
     printf("Processing file %s\n", argv[arg]);
+    RawProcessor.reset_perf_stats();
     timerstart();
     if ((ret = RawProcessor.open_file(argv[arg])) != LIBRAW_SUCCESS)
     {
@@ -161,6 +168,24 @@ int main(int argc, char *argv[])
     }
     float msec = timerend() / (float)rep;
 
+    if (perf)
+    {
+      const libraw_perf_stats_t *ps = RawProcessor.get_perf_stats();
+      printf("%-28s %5s %10s %10s %9s %9s %4s\n", "Stage", "calls",
+             "wall msec", "CPU msec", "read MB", "alloc MB", "thr");
+      for (i = 0; i < LIBRAW_PERF_STAGES; i++)
+      {
+        const libraw_perf_stage_t &st = ps->stage[i];
+        if (!st.calls)
+          continue;
+        printf("%-28s %5d %10.1f %10.1f %9.2f %9.2f %4d\n",
+               libraw_strprogress(LibRaw_progress(1 << i)), st.calls,
+               st.wall_time * 1000.0, st.cpu_time * 1000.0,
+               st.bytes_read / 1048576.0, st.bytes_allocated / 1048576.0,
+               st.threads);
+      }
+    }
+
     if ((ret = RawProcessor.adjust_sizes_info_only()) != LIBRAW_SUCCESS)
     {
       fprintf(stderr, "Cannot adjust sizes for %s: %s\n", argv[arg],
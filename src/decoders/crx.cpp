@@ -18,6 +18,7 @@ it under the terms of the one of two licenses as you choose:
 
 #include "../../internal/libraw_cxx_defs.h"
 #include "../../internal/libraw_safe_math.h"
+#include "../../internal/crx_wavelet.h"
 
 #ifdef _abs
 #undef _abs
@@ -82,20 +83,6 @@ struct CrxBandParam
   bool supportsPartial;
 };
 
-struct CrxWaveletTransform
-{
-  int32_t *subband0Buf;
-  int32_t *subband1Buf;
-  int32_t *subband2Buf;
-  int32_t *subband3Buf;
-  int32_t *lineBuf[8];
-  int16_t curLine;
-  int16_t curH;
-  int8_t fltTapH;
-  int16_t height;
-  int16_t width;
-};
-
 struct CrxSubband
 {
   CrxBandParam *bandParam;
@@ -162,6 +149,7 @@ struct CrxImage
   uint8_t medianBits;
   uint8_t subbandCount;
   uint8_t levels;
+  uint8_t reduceLevels; // finest levels not reconstructed (downscaled output)
   uint8_t nBits;
   uint8_t encType;
   uint8_t tileCols;
@@ -178,14 +166,6 @@ struct CrxImage
 #endif
 };
 
-enum TileFlags
-{
-  E_HAS_TILES_ON_THE_RIGHT = 1,
-  E_HAS_TILES_ON_THE_LEFT = 2,
-  E_HAS_TILES_ON_THE_BOTTOM = 4,
-  E_HAS_TILES_ON_THE_TOP = 8
-};
-
 int32_t exCoefNumTbl[144] = {1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0,
                              0, 1, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 1, 0,
                              0, 0, 1, 2, 2, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 1, 0, 0, 0, 1, 2, 2,
@@ -207,19 +187,8 @@ static inline void crxFillBuffer(CrxBitstream *bitStrm)
   {
     bitStrm->curPos = 0;
     bitStrm->curBufOffset += bitStrm->curBufSize;
-#ifdef LIBRAW_USE_OPENMP
-#pragma omp critical
-#endif
-    {
-#ifndef LIBRAW_USE_OPENMP
-      bitStrm->input->lock();
-#endif
-      bitStrm->input->seek(bitStrm->curBufOffset, SEEK_SET);
-      bitStrm->curBufSize = bitStrm->input->read(bitStrm->mdatBuf, 1, _min(bitStrm->mdatSize, CRX_BUF_SIZE));
-#ifndef LIBRAW_USE_OPENMP
-      bitStrm->input->unlock();
-#endif
-    }
+    INT64 bytes = bitStrm->input->readAt(bitStrm->mdatBuf, _min(bitStrm->mdatSize, CRX_BUF_SIZE), bitStrm->curBufOffset);
+    bitStrm->curBufSize = bytes > 0 ? uint32_t(bytes) : 0;
     if (bitStrm->curBufSize < 1) // nothing read
       throw LIBRAW_EXCEPTION_IO_EOF;
     bitStrm->mdatSize -= bitStrm->curBufSize;
@@ -1125,80 +1094,68 @@ int crxDecodeLineWithIQuantization(CrxSubband *band, CrxQStep *qStep)
   return 0;
 }
 
-void crxHorizontal53(int32_t *lineBufLA, int32_t *lineBufLB, CrxWaveletTransform *wavelet, uint32_t tileFlag)
+// Horizontal 5/3 lifting of one line. The main loop recomputes the previous
+// delta instead of reading it back from lineBuf, so iterations carry no
+// dependency on each other and the compiler is able to vectorize it. GCC 12
+// does so only at -O3 (the CMake Release default), not at the -O2 of the
+// autotools build, where the loop runs scalar at about the old speed.
+static inline void crxHorizontal53Line(int32_t *lineBuf, const int32_t *band0Buf, const int32_t *band1Buf,
+                                       int32_t width, uint32_t tileFlag)
 {
-  int32_t *band0Buf = wavelet->subband0Buf;
-  int32_t *band1Buf = wavelet->subband1Buf;
-  int32_t *band2Buf = wavelet->subband2Buf;
-  int32_t *band3Buf = wavelet->subband3Buf;
+  if (width <= 1)
+  {
+    lineBuf[0] = band0Buf[0];
+    return;
+  }
 
-  if (wavelet->width <= 1)
+  if (tileFlag & E_HAS_TILES_ON_THE_LEFT)
   {
-    lineBufLA[0] = band0Buf[0];
-    lineBufLB[0] = band2Buf[0];
+    lineBuf[0] = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
+    ++band1Buf;
   }
   else
-  {
-    if (tileFlag & E_HAS_TILES_ON_THE_LEFT)
-    {
-      lineBufLA[0] = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
-      lineBufLB[0] = band2Buf[0] - ((band3Buf[0] + band3Buf[1] + 2) >> 2);
-      ++band1Buf;
-      ++band3Buf;
-    }
-    else
-    {
-      lineBufLA[0] = band0Buf[0] - ((band1Buf[0] + 1) >> 1);
-      lineBufLB[0] = band2Buf[0] - ((band3Buf[0] + 1) >> 1);
-    }
-    ++band0Buf;
-    ++band2Buf;
+    lineBuf[0] = band0Buf[0] - ((band1Buf[0] + 1) >> 1);
+  ++band0Buf;
 
-    for (int i = 0; i < wavelet->width - 3; i += 2)
-    {
-      int32_t delta = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
-      lineBufLA[1] = band1Buf[0] + ((delta + lineBufLA[0]) >> 1);
-      lineBufLA[2] = delta;
-
-      delta = band2Buf[0] - ((band3Buf[0] + band3Buf[1] + 2) >> 2);
-      lineBufLB[1] = band3Buf[0] + ((delta + lineBufLB[0]) >> 1);
-      lineBufLB[2] = delta;
-
-      ++band0Buf;
-      ++band1Buf;
-      ++band2Buf;
-      ++band3Buf;
-      lineBufLA += 2;
-      lineBufLB += 2;
-    }
-    if (tileFlag & E_HAS_TILES_ON_THE_RIGHT)
-    {
-      int32_t deltaA = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
-      lineBufLA[1] = band1Buf[0] + ((deltaA + lineBufLA[0]) >> 1);
-
-      int32_t deltaB = band2Buf[0] - ((band3Buf[0] + band3Buf[1] + 2) >> 2);
-      lineBufLB[1] = band3Buf[0] + ((deltaB + lineBufLB[0]) >> 1);
-
-      if (wavelet->width & 1)
-      {
-        lineBufLA[2] = deltaA;
-        lineBufLB[2] = deltaB;
-      }
-    }
-    else if (wavelet->width & 1)
-    {
-      lineBufLA[1] = band1Buf[0] + ((lineBufLA[0] + band0Buf[0] - ((band1Buf[0] + 1) >> 1)) >> 1);
-      lineBufLA[2] = band0Buf[0] - ((band1Buf[0] + 1) >> 1);
+  int32_t steps = (width - 2) >> 1;
+  if (steps > 0)
+  {
+    int32_t delta = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
+    lineBuf[1] = band1Buf[0] + ((delta + lineBuf[0]) >> 1);
+    lineBuf[2] = delta;
+  }
+  for (int32_t i = 1; i < steps; i++)
+  {
+    int32_t prevDelta = band0Buf[i - 1] - ((band1Buf[i - 1] + band1Buf[i] + 2) >> 2);
+    int32_t delta = band0Buf[i] - ((band1Buf[i] + band1Buf[i + 1] + 2) >> 2);
+    lineBuf[2 * i + 1] = band1Buf[i] + ((delta + prevDelta) >> 1);
+    lineBuf[2 * i + 2] = delta;
+  }
+  band0Buf += steps;
+  band1Buf += steps;
+  lineBuf += 2 * steps;
 
-      lineBufLB[1] = band3Buf[0] + ((lineBufLB[0] + band2Buf[0] - ((band3Buf[0] + 1) >> 1)) >> 1);
-      lineBufLB[2] = band2Buf[0] - ((band3Buf[0] + 1) >> 1);
-    }
-    else
-    {
-      lineBufLA[1] = lineBufLA[0] + band1Buf[0];
-      lineBufLB[1] = lineBufLB[0] + band3Buf[0];
-    }
+  if (tileFlag & E_HAS_TILES_ON_THE_RIGHT)
+  {
+    int32_t delta = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
+    lineBuf[1] = band1Buf[0] + ((delta + lineBuf[0]) >> 1);
+    if (width & 1)
+      lineBuf[2] = delta;
   }
+  else if (width & 1)
+  {
+    int32_t delta = band0Buf[0] - ((band1Buf[0] + 1) >> 1);
+    lineBuf[1] = band1Buf[0] + ((delta + lineBuf[0]) >> 1);
+    lineBuf[2] = delta;
+  }
+  else
+    lineBuf[1] = lineBuf[0] + band1Buf[0];
+}
+
+void crxHorizontal53(int32_t *lineBufLA, int32_t *lineBufLB, CrxWaveletTransform *wavelet, uint32_t tileFlag)
+{
+  crxHorizontal53Line(lineBufLA, wavelet->subband0Buf, wavelet->subband1Buf, wavelet->width, tileFlag);
+  crxHorizontal53Line(lineBufLB, wavelet->subband2Buf, wavelet->subband3Buf, wavelet->width, tileFlag);
 }
 
 int32_t *crxIdwt53FilterGetLine(CrxPlaneComp *comp, int32_t level)
@@ -1273,8 +1230,6 @@ int crxIdwt53FilterTransform(CrxPlaneComp *comp, uint32_t level)
               return -1;
           wavelet->subband0Buf = crxIdwt53FilterGetLine(comp, level - 1);
         }
-        int32_t *band0Buf = wavelet->subband0Buf;
-        int32_t *band1Buf = wavelet->subband1Buf;
         int32_t *lineBufH0 = wavelet->lineBuf[wavelet->fltTapH + 3];
         int32_t *lineBufH1 = wavelet->lineBuf[(wavelet->fltTapH + 1) % 5 + 3];
         int32_t *lineBufH2 = wavelet->lineBuf[(wavelet->fltTapH + 2) % 5 + 3];
@@ -1285,47 +1240,7 @@ int crxIdwt53FilterTransform(CrxPlaneComp *comp, uint32_t level)
         wavelet->lineBuf[2] = lineBufL1;
 
         // process L bands
-        if (wavelet->width <= 1)
-        {
-          lineBufL0[0] = band0Buf[0];
-        }
-        else
-        {
-          if (comp->tileFlag & E_HAS_TILES_ON_THE_LEFT)
-          {
-            lineBufL0[0] = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
-            ++band1Buf;
-          }
-          else
-          {
-            lineBufL0[0] = band0Buf[0] - ((band1Buf[0] + 1) >> 1);
-          }
-          ++band0Buf;
-          for (int i = 0; i < wavelet->width - 3; i += 2)
-          {
-            int32_t delta = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
-            lineBufL0[1] = band1Buf[0] + ((lineBufL0[0] + delta) >> 1);
-            lineBufL0[2] = delta;
-            ++band0Buf;
-            ++band1Buf;
-            lineBufL0 += 2;
-          }
-          if (comp->tileFlag & E_HAS_TILES_ON_THE_RIGHT)
-          {
-            int32_t delta = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
-            lineBufL0[1] = band1Buf[0] + ((lineBufL0[0] + delta) >> 1);
-            if (wavelet->width & 1)
-              lineBufL0[2] = delta;
-          }
-          else if (wavelet->width & 1)
-          {
-            int32_t delta = band0Buf[0] - ((band1Buf[0] + 1) >> 1);
-            lineBufL0[1] = band1Buf[0] + ((lineBufL0[0] + delta) >> 1);
-            lineBufL0[2] = delta;
-          }
-          else
-            lineBufL0[1] = band1Buf[0] + lineBufL0[0];
-        }
+        crxHorizontal53Line(lineBufL0, wavelet->subband0Buf, wavelet->subband1Buf, wavelet->width, comp->tileFlag);
 
         // process H bands
         lineBufL0 = wavelet->lineBuf[0];
@@ -1366,11 +1281,6 @@ int crxIdwt53FilterTransform(CrxPlaneComp *comp, uint32_t level)
       wavelet->subband0Buf = crxIdwt53FilterGetLine(comp, level - 1);
     }
 
-    int32_t *band0Buf = wavelet->subband0Buf;
-    int32_t *band1Buf = wavelet->subband1Buf;
-    int32_t *band2Buf = wavelet->subband2Buf;
-    int32_t *band3Buf = wavelet->subband3Buf;
-
     int32_t *lineBufL0 = wavelet->lineBuf[0];
     int32_t *lineBufL1 = wavelet->lineBuf[1];
     int32_t *lineBufL2 = wavelet->lineBuf[2];
@@ -1382,74 +1292,7 @@ int crxIdwt53FilterTransform(CrxPlaneComp *comp, uint32_t level)
     wavelet->lineBuf[2] = lineBufL1;
 
     // process L bands
-    if (wavelet->width <= 1)
-    {
-      lineBufL0[0] = band0Buf[0];
-      lineBufL1[0] = band2Buf[0];
-    }
-    else
-    {
-      if (comp->tileFlag & E_HAS_TILES_ON_THE_LEFT)
-      {
-        lineBufL0[0] = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
-        lineBufL1[0] = band2Buf[0] - ((band3Buf[0] + band3Buf[1] + 2) >> 2);
-        ++band1Buf;
-        ++band3Buf;
-      }
-      else
-      {
-        lineBufL0[0] = band0Buf[0] - ((band1Buf[0] + 1) >> 1);
-        lineBufL1[0] = band2Buf[0] - ((band3Buf[0] + 1) >> 1);
-      }
-      ++band0Buf;
-      ++band2Buf;
-      for (int i = 0; i < wavelet->width - 3; i += 2)
-      {
-        int32_t delta = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
-        lineBufL0[1] = band1Buf[0] + ((delta + lineBufL0[0]) >> 1);
-        lineBufL0[2] = delta;
-
-        delta = band2Buf[0] - ((band3Buf[0] + band3Buf[1] + 2) >> 2);
-        lineBufL1[1] = band3Buf[0] + ((delta + lineBufL1[0]) >> 1);
-        lineBufL1[2] = delta;
-
-        ++band0Buf;
-        ++band1Buf;
-        ++band2Buf;
-        ++band3Buf;
-        lineBufL0 += 2;
-        lineBufL1 += 2;
-      }
-      if (comp->tileFlag & E_HAS_TILES_ON_THE_RIGHT)
-      {
-        int32_t deltaA = band0Buf[0] - ((band1Buf[0] + band1Buf[1] + 2) >> 2);
-        lineBufL0[1] = band1Buf[0] + ((deltaA + lineBufL0[0]) >> 1);
-
-        int32_t deltaB = band2Buf[0] - ((band3Buf[0] + band3Buf[1] + 2) >> 2);
-        lineBufL1[1] = band3Buf[0] + ((deltaB + lineBufL1[0]) >> 1);
-
-        if (wavelet->width & 1)
-        {
-          lineBufL0[2] = deltaA;
-          lineBufL1[2] = deltaB;
-        }
-      }
-      else if (wavelet->width & 1)
-      {
-        int32_t delta = band0Buf[0] - ((band1Buf[0] + 1) >> 1);
-        lineBufL0[1] = band1Buf[0] + ((delta + lineBufL0[0]) >> 1);
-        lineBufL0[2] = delta;
-
-        delta = band2Buf[0] - ((band3Buf[0] + 1) >> 1);
-        lineBufL1[1] = band3Buf[0] + ((delta + lineBufL1[0]) >> 1);
-        lineBufL1[2] = delta;
-      }
-      else
-      {
-        lineBufL0[1] = lineBufL0[0] + band1Buf[0];
-        lineBufL1[1] = lineBufL1[0] + band3Buf[0];
-      }
-    }
+    crxHorizontal53(lineBufL0, lineBufL1, wavelet, comp->tileFlag);
 
     // process H bands
     lineBufL0 = wavelet->lineBuf[0];
@@ -1657,6 +1500,15 @@ void crxFreeSubbandData(CrxImage *image, CrxPlaneComp *comp)
   }
 }
 
+// size of a tile (or plane) side after dropping `shift` wavelet levels
+static inline int crxReducedSize(int size, int shift) { return (size + (1 << shift) - 1) >> shift; }
+
+static int crxReducedPlaneSize(int planeSize, int tileSize, int shift)
+{
+  int tiles = (planeSize + tileSize - 1) / tileSize;
+  return (tiles - 1) * crxReducedSize(tileSize, shift) + crxReducedSize(planeSize - tileSize * (tiles - 1), shift);
+}
+
 void crxConvertPlaneLine(CrxImage *img, int imageRow, int imageCol = 0, int plane = 0, int32_t *lineData = 0,
                          int lineLength = 0)
 {
@@ -1866,8 +1718,9 @@ int crxSetupSubbandData(CrxImage *img, CrxPlaneComp *planeComp, const CrxTile *t
     }
   }
 
-  // decoding params and bitstream initialisation
-  for (int32_t subbandNum = 0; subbandNum < toSubbands; subbandNum++)
+  // decoding params and bitstream initialisation, skipped levels are never read
+  int32_t usedSubbands = toSubbands - 3 * img->reduceLevels;
+  for (int32_t subbandNum = 0; subbandNum < usedSubbands; subbandNum++)
   {
     if (subbands[subbandNum].dataSize)
     {
@@ -1889,58 +1742,84 @@ int crxSetupSubbandData(CrxImage *img, CrxPlaneComp *planeComp, const CrxTile *t
   return 0;
 }
 
-int LibRaw::crxDecodePlane(void *p, uint32_t planeNumber)
+// returns 0 if OK, 1 if the rest of the plane is to be skipped, -1 on error
+int LibRaw::crxDecodeTile(void *p, int tileNumber, uint32_t planeNumber)
 {
   CrxImage *img = (CrxImage *)p;
-  int imageRow = 0;
-  for (int tRow = 0; tRow < img->tileRows; tRow++)
-  {
-    int imageCol = 0;
-    for (int tCol = 0; tCol < img->tileCols; tCol++)
-    {
-      CrxTile *tile = img->tiles + tRow * img->tileCols + tCol;
-      CrxPlaneComp *planeComp = tile->comps + planeNumber;
-      uint64_t tileMdatOffset = tile->dataOffset + tile->mdatQPDataSize + tile->mdatExtraSize + planeComp->dataOffset;
-
-      // decode single tile
-      if (crxSetupSubbandData(img, planeComp, tile, tileMdatOffset))
-        return -1;
+  int tRow = tileNumber / img->tileCols;
+  int tCol = tileNumber % img->tileCols;
+  int imageRow = 0, imageCol = 0;
+  for (int r = 0; r < tRow; r++)
+    imageRow += crxReducedSize(img->tiles[r * img->tileCols].height, img->reduceLevels);
+  for (int c = 0; c < tCol; c++)
+    imageCol += crxReducedSize(img->tiles[tRow * img->tileCols + c].width, img->reduceLevels);
+
+  CrxTile *tile = img->tiles + tileNumber;
+  CrxPlaneComp *planeComp = tile->comps + planeNumber;
+  uint64_t tileMdatOffset = tile->dataOffset + tile->mdatQPDataSize + tile->mdatExtraSize + planeComp->dataOffset;
+
+  // decode single tile
+  if (crxSetupSubbandData(img, planeComp, tile, tileMdatOffset))
+    return -1;
 
-      if (img->levels)
+  if (img->levels)
+  {
+    // a downscaled tile is the low band of the coarser level: its lines start
+    // at the tile origin, overlap with the next tiles is cut off at the end
+    int32_t levels = img->levels - img->reduceLevels;
+    int32_t width = crxReducedSize(tile->width, img->reduceLevels);
+    int32_t height = crxReducedSize(tile->height, img->reduceLevels);
+    if (!levels)
+    {
+      for (int i = 0; i < height; ++i)
       {
-        if (crxIdwt53FilterInitialize(planeComp, img->levels, tile->qStep))
+        if (crxDecodeLineWithIQuantization(planeComp->subBands, tile->qStep))
           return -1;
-        for (int i = 0; i < tile->height; ++i)
-        {
-          if (crxIdwt53FilterDecode(planeComp, img->levels - 1, tile->qStep) ||
-              crxIdwt53FilterTransform(planeComp, img->levels - 1))
-            return -1;
-          int32_t *lineData = crxIdwt53FilterGetLine(planeComp, img->levels - 1);
-          crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
-        }
+        int32_t *lineData = (int32_t *)planeComp->subBands->bandBuf;
+        crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, width);
       }
-      else
-      {
-        // we have the only subband in this case
-        if (!planeComp->subBands->dataSize)
-        {
-          memset(planeComp->subBands->bandBuf, 0, planeComp->subBands->bandSize);
-          return 0;
-        }
+      return 0;
+    }
 
-        for (int i = 0; i < tile->height; ++i)
-        {
-          if (crxDecodeLine(planeComp->subBands->bandParam, planeComp->subBands->bandBuf))
-            return -1;
-          int32_t *lineData = (int32_t *)planeComp->subBands->bandBuf;
-          crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
-        }
-      }
-      imageCol += tile->width;
+    if (crxIdwt53FilterInitialize(planeComp, levels, tile->qStep))
+      return -1;
+    for (int i = 0; i < height; ++i)
+    {
+      if (crxIdwt53FilterDecode(planeComp, levels - 1, tile->qStep) || crxIdwt53FilterTransform(planeComp, levels - 1))
+        return -1;
+      int32_t *lineData = crxIdwt53FilterGetLine(planeComp, levels - 1);
+      crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, width);
+    }
+  }
+  else
+  {
+    // we have the only subband in this case
+    if (!planeComp->subBands->dataSize)
+    {
+      memset(planeComp->subBands->bandBuf, 0, planeComp->subBands->bandSize);
+      return 1;
+    }
+
+    for (int i = 0; i < tile->height; ++i)
+    {
+      if (crxDecodeLine(planeComp->subBands->bandParam, planeComp->subBands->bandBuf))
+        return -1;
+      int32_t *lineData = (int32_t *)planeComp->subBands->bandBuf;
+      crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
     }
-    imageRow += img->tiles[tRow * img->tileCols].height;
   }
+  return 0;
+}
 
+int LibRaw::crxDecodePlane(void *p, uint32_t planeNumber)
+{
+  CrxImage *img = (CrxImage *)p;
+  for (int tileNumber = 0; tileNumber < img->tileRows * img->tileCols; tileNumber++)
+  {
+    int ret = crxDecodeTile(img, tileNumber, planeNumber);
+    if (ret)
+      return ret < 0 ? -1 : 0;
+  }
   return 0;
 }
 
@@ -2538,6 +2417,7 @@ int crxSetupImageData(crx_data_header_t *hdr, CrxImage *img, int16_t *outBuf, in
 
   img->tiles = 0;
   img->levels = hdr->imageLevels;
+  img->reduceLevels = _min(hdr->reduceLevels, hdr->imageLevels);
   img->subbandCount = 3 * img->levels + 1; // 3 bands per level + one last LL
   img->nPlanes = hdr->nPlanes;
   img->nBits = hdr->nBits;
@@ -2566,7 +2446,7 @@ int crxSetupImageData(crx_data_header_t *hdr, CrxImage *img, int16_t *outBuf, in
       return -1;
   }
 
-  int32_t rowSize = 2 * img->planeWidth;
+  int32_t rowSize = 2 * crxReducedPlaneSize(img->planeWidth, hdr->tileWidth, img->reduceLevels);
 
   if (img->nPlanes == 1)
     img->outBufs[0] = outBuf;
@@ -2608,7 +2488,13 @@ int crxSetupImageData(crx_data_header_t *hdr, CrxImage *img, int16_t *outBuf, in
     }
 
   // read header
-  return crxReadImageHeaders(hdr, img, mdatHdrPtr, mdatHdrSize);
+  if (crxReadImageHeaders(hdr, img, mdatHdrPtr, mdatHdrSize))
+    return -1;
+
+  // tiles keep their coded sizes, the planes are written at the output size
+  img->planeWidth = crxReducedPlaneSize(img->planeWidth, hdr->tileWidth, img->reduceLevels);
+  img->planeHeight = crxReducedPlaneSize(img->planeHeight, hdr->tileHeight, img->reduceLevels);
+  return 0;
 }
 
 int crxFreeImageData(CrxImage *img)
@@ -2644,18 +2530,44 @@ int crxFreeImageData(CrxImage *img)
 void LibRaw::crxLoadDecodeLoop(void *img, int nPlanes)
 {
 #ifdef LIBRAW_USE_OPENMP
-  int results[4] ={0,0,0,0}; // nPlanes is always <= 4
-#pragma omp parallel for
+  // every tile of every plane is an independent task with its own
+  // subband buffers and bitstreams
+  CrxImage *image = (CrxImage *)img;
+  int nTiles = image->tileRows * image->tileCols;
+  int lastTile[4]; // nPlanes is always <= 4
   for (int32_t plane = 0; plane < nPlanes; ++plane)
-   try {
-    results[plane] = crxDecodePlane(img, plane);
-   } catch (...) {
-    results[plane] = 1;
-   }
+  {
+    // without wavelet levels a plane stops at its first tile with no data
+    lastTile[plane] = nTiles - 1;
+    if (!image->levels)
+      for (int t = 0; t < nTiles; t++)
+        if (!image->tiles[t].comps[plane].subBands->dataSize)
+        {
+          lastTile[plane] = t;
+          break;
+        }
+  }
+  std::vector<int> results(nTiles * nPlanes, 0);
+#pragma omp parallel for schedule(dynamic)
+  for (int task = 0; task < nTiles * nPlanes; ++task)
+  {
+    int tile = task / nPlanes, plane = task % nPlanes;
+    if (tile > lastTile[plane])
+      continue;
+    try {
+      results[task] = crxDecodeTile(img, tile, plane) < 0;
+    } catch (...) {
+      results[task] = 1;
+    }
+  }
 
   for (int32_t plane = 0; plane < nPlanes; ++plane)
-    if (results[plane])
-      derror();
+    for (int tile = 0; tile <= lastTile[plane]; ++tile)
+      if (results[tile * nPlanes + plane])
+      {
+        derror();
+        break;
+      }
 #else
   for (int32_t plane = 0; plane < nPlanes; ++plane)
     if (crxDecodePlane(img, plane))
@@ -2800,6 +2712,49 @@ int LibRaw::crxParseImageHeader(uchar *cmp1TagData, int nTrack, INT64 size)
   return 0;
 }
 
+static ushort crxReducedEven(ushort value, int shift) { return ((value >> 1) >> shift) << 1; }
+
+// Shrinks the sizes set up by identify() to what crxLoadRaw() produces when
+// rawparams.cr3_downscale asks to leave out the finest wavelet levels: each
+// CFA plane is replaced by the low band of a coarser level, so the result
+// is still a Bayer image with the same CFA pattern.
+void LibRaw::crxSetupDownscale()
+{
+  int nTrack = libraw_internal_data.unpacker_data.crx_track_selected;
+  if (nTrack < 0 || nTrack >= LIBRAW_CRXTRACKS_MAXCOUNT)
+    return;
+
+  crx_data_header_t *hdr = &libraw_internal_data.unpacker_data.crx_header[nTrack];
+  hdr->reduceLevels = 0;
+  // plane tiles below 0x16 are rejected by crxSetupImageData() anyway
+  if (!imgdata.rawparams.cr3_downscale || hdr->nPlanes != 4 || !hdr->imageLevels || hdr->tileWidth < 0x2C ||
+      hdr->tileHeight < 0x2C)
+    return;
+
+  int shift = _min(imgdata.rawparams.cr3_downscale, (unsigned)hdr->imageLevels);
+  hdr->reduceLevels = shift;
+
+  imgdata.sizes.raw_width = 2 * crxReducedPlaneSize(hdr->f_width >> 1, hdr->tileWidth >> 1, shift);
+  imgdata.sizes.raw_height = 2 * crxReducedPlaneSize(hdr->f_height >> 1, hdr->tileHeight >> 1, shift);
+  imgdata.sizes.left_margin = crxReducedEven(imgdata.sizes.left_margin, shift);
+  imgdata.sizes.top_margin = crxReducedEven(imgdata.sizes.top_margin, shift);
+  imgdata.sizes.width = _min(crxReducedEven(imgdata.sizes.width, shift),
+                             imgdata.sizes.raw_width - imgdata.sizes.left_margin);
+  imgdata.sizes.height = _min(crxReducedEven(imgdata.sizes.height, shift),
+                              imgdata.sizes.raw_height - imgdata.sizes.top_margin);
+
+  for (int i = 0; i < 2; i++)
+  {
+    libraw_raw_inset_crop_t &crop = imgdata.sizes.raw_inset_crops[i];
+    if (crop.cleft == 0xffff || crop.ctop == 0xffff)
+      continue;
+    crop.cleft = crxReducedEven(crop.cleft, shift);
+    crop.ctop = crxReducedEven(crop.ctop, shift);
+    crop.cwidth = crxReducedEven(crop.cwidth, shift);
+    crop.cheight = crxReducedEven(crop.cheight, shift);
+  }
+}
+
 #undef _abs
 #undef _min
 #undef _constrain
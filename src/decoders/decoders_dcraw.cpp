@@ -16,6 +16,7 @@
 
  */
 
+#include "../../internal/losslessjpeg.h"
 #include "../../internal/dcraw_defs.h"
 #include "../../internal/libraw_cameraids.h"
 
@@ -358,6 +359,74 @@ void LibRaw::ljpeg_end(struct jhead *jh)
   int c;
   FORC4 if (jh->free[c]) free(jh->free[c]);
   free(jh->row);
+  delete (LibRaw_LjpegStream *)jh->rowdec;
+  jh->rowdec = 0;
+}
+
+/*
+   Fast path for ljpeg_row(): switch it to the table driven
+   LibRaw_LjpegRowDecoder for the stream that ljpeg_start() has just parsed
+   at offset start. Call it after any change of jh->wide. size limits the
+   copy for non memory-based datastreams, 0 means memory-based ones only.
+   The fast path is taken only if it agrees with jh on the stream geometry.
+   dcraw's decoder stays the reference: the fast path doesn't report
+   errors, if ljpeg_rows_failed() after decoding the caller should decode
+   again with plain ljpeg_start() to get dcraw's results and errors.
+   It is not a replacement for dcraw's decoder: the Hasselblad, Kodak,
+   ljpeg_idct() and Phase One decoders use only the Huffman tables from
+   ljpeg_start() with their own bit readers (getbits(), ljpeg_diff()).
+*/
+void LibRaw::ljpeg_rows_start(struct jhead *jh, INT64 start, INT64 size)
+{
+  if (jh->rowdec || jh->algo != 0xc3)
+    return;
+  INT64 avail = ifp->size() - start;
+  if (avail < 4)
+    return;
+  if (ifp->data_at(start, size_t(avail)))
+    size = avail; // mapped, nothing is copied
+  else
+  {
+    /* Copy no more than the scan may take: the headers parsed so far, the
+       longest Huffman code and diff (16 + bits bits) per sample and a
+       marker per restart interval. A longer scan underruns the copy and
+       is decoded again by dcraw's decoder. */
+    INT64 samples = INT64(jh->wide) * jh->high * jh->clrs;
+    INT64 restarts = jh->restart > 0 ? INT64(jh->wide) * jh->high / jh->restart + 1 : 1;
+    INT64 bound = ftell(ifp) - start + samples * (jh->bits + 16) / 8 + restarts * 8;
+    size = MIN(size, MIN(avail, bound));
+  }
+  if (size < 4 || size >= INT64(UINT_MAX) ||
+      size > INT64(imgdata.rawparams.max_raw_memory_mb) * INT64(1024 * 1024))
+    return;
+
+  LibRaw_LjpegStream *ls = 0;
+  try
+  {
+    ls = new LibRaw_LjpegStream(ifp, start, unsigned(size),
+                                dng_version && dng_version < 0x1010000);
+  }
+  catch (...)
+  {
+    return;
+  }
+  LibRaw_LjpegRowDecoder &rd = ls->rows;
+  if (jh->wide > 0 && unsigned(jh->wide) < rd.wide && jh->sraw)
+    rd.narrow(unsigned(jh->wide)); // canon_sraw_load_raw() halves it
+  if (!rd.valid() || int(rd.wide) != jh->wide || int(rd.high) != jh->high ||
+      int(rd.clrs) != jh->clrs || int(rd.sraw) != jh->sraw ||
+      int(rd.bits) != jh->bits || int(rd.psv) != jh->psv ||
+      int(ls->dec.restart_interval) != jh->restart)
+  {
+    delete ls;
+    return;
+  }
+  jh->rowdec = ls;
+}
+
+int LibRaw::ljpeg_rows_failed(struct jhead *jh)
+{
+  return jh->rowdec && ((LibRaw_LjpegStream *)jh->rowdec)->rows.errors;
 }
 
 int LibRaw::ljpeg_diff(ushort *huff)
@@ -382,6 +451,9 @@ ushort *LibRaw::ljpeg_row(int jrow, struct jhead *jh)
   int col, c, diff, pred, spred = 0;
   ushort mark = 0, *row[3];
 
+  if (jh->rowdec) // fast path, see ljpeg_rows_start()
+    return ((LibRaw_LjpegStream *)jh->rowdec)->rows.next_row();
+
   // Use the optimized, unrolled version if possible.
   if (!jh->sraw)
     return ljpeg_row_unrolled(jrow, jh);
@@ -547,7 +619,10 @@ void LibRaw::lossless_jpeg_load_raw()
   int jwide, jhigh, jrow, jcol, val, jidx, i, j, row = 0, col = 0;
   struct jhead jh;
   ushort *rp;
+  INT64 start = ftell(ifp);
+  bool fast = true;
 
+restart:
   if (!ljpeg_start(&jh, 0))
     return;
 
@@ -557,6 +632,9 @@ void LibRaw::lossless_jpeg_load_raw()
   if(cr2_slice[0] && !cr2_slice[1])
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
 
+  if (fast)
+    ljpeg_rows_start(&jh, start, ifp->size() - start);
+
   jwide = jh.wide * jh.clrs;
   jhigh = jh.high;
   if (jh.clrs == 4 && jwide >= raw_width * 2)
@@ -607,6 +685,14 @@ void LibRaw::lossless_jpeg_load_raw()
     ljpeg_end(&jh);
     throw;
   }
+  if (ljpeg_rows_failed(&jh)) // fast path gave up, redo with dcraw's decoder
+  {
+    ljpeg_end(&jh);
+    fseek(ifp, start, SEEK_SET);
+    row = col = 0;
+    fast = false;
+    goto restart;
+  }
   ljpeg_end(&jh);
 }
 
@@ -618,17 +704,24 @@ void LibRaw::canon_sraw_load_raw()
   int v[3] = {0, 0, 0}, ver, hue;
   int saved_w = width, saved_h = height;
   char *cp;
+  INT64 start = ftell(ifp);
+  bool fast = true;
 
   if(!image)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
 
+restart:
   if (!ljpeg_start(&jh, 0) || jh.clrs < 4)
     return;
-  jwide = (jh.wide >>= 1) * jh.clrs;
+  jwide = (jh.wide >> 1) * jh.clrs;
 
   if (jwide < 32 || jwide > 65535)
 	  throw LIBRAW_EXCEPTION_IO_CORRUPT;
 
+  jh.wide >>= 1;
+  if (fast)
+    ljpeg_rows_start(&jh, start, ifp->size() - start);
+
   if (load_flags & 256)
   {
     width = raw_width;
@@ -689,6 +782,14 @@ void LibRaw::canon_sraw_load_raw()
     ljpeg_end(&jh);
     throw;
   }
+  if (ljpeg_rows_failed(&jh)) // fast path gave up, redo with dcraw's decoder
+  {
+    ljpeg_end(&jh);
+    fseek(ifp, start, SEEK_SET);
+    jrow = jcol = 0;
+    fast = false;
+    goto restart;
+  }
 
   if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SRAW_NO_INTERPOLATE)
   {
@@ -1123,58 +1224,112 @@ unsigned LibRaw::pana_data(int nb, unsigned *bytes)
 #endif
 }
 
+void LibRaw::panasonic_decode_block(const uchar *bytes, INT64 block)
+{
+  const int enc_blck_size = pana_bpp == 12 ? 10 : 9;
+  const int blocksperrow = (raw_width + enc_blck_size - 1) / enc_blck_size;
+  const int row = int(block / blocksperrow);
+  const int col = int(block % blocksperrow) * enc_blck_size;
+  ushort pix[10];
+
+  if (pana_bpp == 12)
+  {
+    pix[0] = ((bytes[1] & 0xF) << 8) + bytes[0];
+    pix[1] = 16 * bytes[2] + (bytes[1] >> 4);
+    pix[2] = ((bytes[4] & 0xF) << 8) + bytes[3];
+    pix[3] = 16 * bytes[5] + (bytes[4] >> 4);
+    pix[4] = ((bytes[7] & 0xF) << 8) + bytes[6];
+    pix[5] = 16 * bytes[8] + (bytes[7] >> 4);
+    pix[6] = ((bytes[10] & 0xF) << 8) + bytes[9];
+    pix[7] = 16 * bytes[11] + (bytes[10] >> 4);
+    pix[8] = ((bytes[13] & 0xF) << 8) + bytes[12];
+    pix[9] = 16 * bytes[14] + (bytes[13] >> 4);
+  }
+  else if (pana_bpp == 14)
+  {
+    pix[0] = bytes[0] + ((bytes[1] & 0x3F) << 8);
+    pix[1] = (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
+    pix[2] = (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
+    pix[3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
+    pix[4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
+    pix[5] = (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
+    pix[6] = (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
+    pix[7] = ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
+    pix[8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
+  }
+  else
+    return;
+  /* the last block of a row used to spill into the next row, where it was
+     overwritten by that row's first block */
+  ushort *dest = raw_image + size_t(row) * raw_width + col;
+  for (int i = 0; i < enc_blck_size && col + i < raw_width; i++)
+    dest[i] = pix[i];
+}
+
+void LibRaw::panasonic_decode_loop(uchar *pages, int npages, INT64 block0,
+                                   INT64 nblocks)
+{
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int p = 0; p < npages; p++)
+  {
+    const INT64 first = block0 + INT64(p) * 1024;
+    for (int q = 0; q < 1024 && first + q < nblocks; q++)
+      panasonic_decode_block(pages + p * 0x4000 + q * 16, first + q);
+  }
+}
+
 void LibRaw::panasonic_load_raw()
 {
   int row, col, i, j, sh = 0, pred[2], nonz[2];
-  unsigned bytes[16];
-  memset(bytes,0,sizeof(bytes)); // make gcc11 happy
-  ushort *raw_block_data;
 
   pana_data(0, 0);
 
-  int enc_blck_size = pana_bpp == 12 ? 10 : 9;
   if (pana_encoding == 5)
   {
-    for (row = 0; row < raw_height; row++)
+    /*
+      16-byte blocks of 9 or 10 pixels, 1024 blocks in each 0x4000-byte
+      page: pages are read in bands and their blocks decoded in parallel.
+      data holds the previous page followed by the band; bytes missing on
+      a short read keep the previous page contents, as they did in the
+      single pana_data() buffer.
+    */
+    const int enc_blck_size = pana_bpp == 12 ? 10 : 9;
+    const INT64 nblocks =
+        INT64(raw_height) * ((raw_width + enc_blck_size - 1) / enc_blck_size);
+    const int band_pages = 64;
+    const unsigned lf = load_flags;
+    if (nblocks > 0 && lf > 0x4000)
+      throw LIBRAW_EXCEPTION_IO_BADFILE;
+    uchar *data = (uchar *)calloc(0x4000 * (band_pages + 1), 1);
+    try
     {
-      raw_block_data = raw_image + row * raw_width;
-      checkCancel();
-      for (col = 0; col < raw_width; col += enc_blck_size)
+      for (INT64 block0 = 0; block0 < nblocks; block0 += band_pages * 1024)
       {
-        pana_data(0, bytes);
-
-        if (pana_bpp == 12)
-        {
-          raw_block_data[col] = ((bytes[1] & 0xF) << 8) + bytes[0];
-          raw_block_data[col + 1] = 16 * bytes[2] + (bytes[1] >> 4);
-          raw_block_data[col + 2] = ((bytes[4] & 0xF) << 8) + bytes[3];
-          raw_block_data[col + 3] = 16 * bytes[5] + (bytes[4] >> 4);
-          raw_block_data[col + 4] = ((bytes[7] & 0xF) << 8) + bytes[6];
-          raw_block_data[col + 5] = 16 * bytes[8] + (bytes[7] >> 4);
-          raw_block_data[col + 6] = ((bytes[10] & 0xF) << 8) + bytes[9];
-          raw_block_data[col + 7] = 16 * bytes[11] + (bytes[10] >> 4);
-          raw_block_data[col + 8] = ((bytes[13] & 0xF) << 8) + bytes[12];
-          raw_block_data[col + 9] = 16 * bytes[14] + (bytes[13] >> 4);
-        }
-        else if (pana_bpp == 14)
+        checkCancel();
+        const int npages =
+            int(MIN(INT64(band_pages), (nblocks - block0 + 1023) / 1024));
+        uchar *pg = data + 0x4000;
+        for (int p = 0; p < npages; p++, pg += 0x4000)
         {
-          raw_block_data[col] = bytes[0] + ((bytes[1] & 0x3F) << 8);
-          raw_block_data[col + 1] =
-              (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
-          raw_block_data[col + 2] =
-              (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
-          raw_block_data[col + 3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
-          raw_block_data[col + 4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
-          raw_block_data[col + 5] =
-              (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
-          raw_block_data[col + 6] =
-              (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
-          raw_block_data[col + 7] =
-              ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
-          raw_block_data[col + 8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
+          size_t got1 = lf < 0x4000 ? fread(pg + lf, 1, 0x4000 - lf, ifp) : 0;
+          size_t got0 = fread(pg, 1, lf, ifp);
+          if (got1 < 0x4000 - lf)
+            memcpy(pg + lf + got1, pg + lf + got1 - 0x4000, 0x4000 - lf - got1);
+          if (got0 < lf)
+            memcpy(pg + got0, pg + got0 - 0x4000, lf - got0);
         }
+        panasonic_decode_loop(data + 0x4000, npages, block0, nblocks);
+        memcpy(data, data + 0x4000 * npages, 0x4000);
       }
     }
+    catch (...)
+    {
+      free(data);
+      throw;
+    }
+    free(data);
   }
   else
   {
@@ -1406,109 +1561,160 @@ void LibRaw::sony_arw_load_raw()
   }
 }
 
-void LibRaw::sony_arw2_load_raw()
+void LibRaw::sony_arw2_decode_row(uchar *data, int row)
 {
-  uchar *data, *dp;
+  uchar *dp, *bp, tail[18];
   ushort pix[16];
-  int row, col, val, max, min, imax, imin, sh, bit, i;
+  int col, val, max, min, imax, imin, sh, bit, i;
 
-  data = (uchar *)calloc(raw_width + 1,1);
-  try
+  for (dp = data, col = 0; col < raw_width - 30; dp += 16)
   {
-    for (row = 0; row < height; row++)
+    bp = dp;
+    /* a block with imax == imin reads past its 16 bytes; for the last one
+       in the row that was the zero padding of the old one-row buffer */
+    if (dp + 16 >= data + raw_width)
     {
-      checkCancel();
-      fread(data, 1, raw_width, ifp);
-      for (dp = data, col = 0; col < raw_width - 30; dp += 16)
-      {
-        max = 0x7ff & (val = sget4(dp));
-        min = 0x7ff & val >> 11;
-        imax = 0x0f & val >> 22;
-        imin = 0x0f & val >> 26;
-        for (sh = 0; sh < 4 && 0x80 << sh <= max - min; sh++)
-          ;
-        /* flag checks if outside of loop */
-        if (!(imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_ALLFLAGS) // no flag set
-            || (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_DELTATOVALUE))
-        {
-          for (bit = 30, i = 0; i < 16; i++)
-            if (i == imax)
-              pix[i] = max;
-            else if (i == imin)
-              pix[i] = min;
-            else
-            {
-              pix[i] =
-                  ((sget2(dp + (bit >> 3)) >> (bit & 7) & 0x7f) << sh) + min;
-              if (pix[i] > 0x7ff)
-                pix[i] = 0x7ff;
-              bit += 7;
-            }
-        }
-        else if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_BASEONLY)
+      memcpy(tail, dp, 16);
+      tail[16] = tail[17] = 0;
+      bp = tail;
+    }
+    max = 0x7ff & (val = sget4(bp));
+    min = 0x7ff & val >> 11;
+    imax = 0x0f & val >> 22;
+    imin = 0x0f & val >> 26;
+    for (sh = 0; sh < 4 && 0x80 << sh <= max - min; sh++)
+      ;
+    /* flag checks if outside of loop */
+    if (!(imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_ALLFLAGS) // no flag set
+        || (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_DELTATOVALUE))
+    {
+      for (bit = 30, i = 0; i < 16; i++)
+        if (i == imax)
+          pix[i] = max;
+        else if (i == imin)
+          pix[i] = min;
+        else
         {
-          for (bit = 30, i = 0; i < 16; i++)
-            if (i == imax)
-              pix[i] = max;
-            else if (i == imin)
-              pix[i] = min;
-            else
-              pix[i] = 0;
+          pix[i] =
+              ((sget2(bp + (bit >> 3)) >> (bit & 7) & 0x7f) << sh) + min;
+          if (pix[i] > 0x7ff)
+            pix[i] = 0x7ff;
+          bit += 7;
         }
-        else if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_DELTAONLY)
+    }
+    else if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_BASEONLY)
+    {
+      for (bit = 30, i = 0; i < 16; i++)
+        if (i == imax)
+          pix[i] = max;
+        else if (i == imin)
+          pix[i] = min;
+        else
+          pix[i] = 0;
+    }
+    else if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_DELTAONLY)
+    {
+      for (bit = 30, i = 0; i < 16; i++)
+        if (i == imax)
+          pix[i] = 0;
+        else if (i == imin)
+          pix[i] = 0;
+        else
         {
-          for (bit = 30, i = 0; i < 16; i++)
-            if (i == imax)
-              pix[i] = 0;
-            else if (i == imin)
-              pix[i] = 0;
-            else
-            {
-              pix[i] =
-                  ((sget2(dp + (bit >> 3)) >> (bit & 7) & 0x7f) << sh) + min;
-              if (pix[i] > 0x7ff)
-                pix[i] = 0x7ff;
-              bit += 7;
-            }
+          pix[i] =
+              ((sget2(bp + (bit >> 3)) >> (bit & 7) & 0x7f) << sh) + min;
+          if (pix[i] > 0x7ff)
+            pix[i] = 0x7ff;
+          bit += 7;
         }
-        else if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_DELTAZEROBASE)
+    }
+    else if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_DELTAZEROBASE)
+    {
+      for (bit = 30, i = 0; i < 16; i++)
+        if (i == imax)
+          pix[i] = 0;
+        else if (i == imin)
+          pix[i] = 0;
+        else
         {
-          for (bit = 30, i = 0; i < 16; i++)
-            if (i == imax)
-              pix[i] = 0;
-            else if (i == imin)
-              pix[i] = 0;
-            else
-            {
-              pix[i] = ((sget2(dp + (bit >> 3)) >> (bit & 7) & 0x7f) << sh);
-              if (pix[i] > 0x7ff)
-                pix[i] = 0x7ff;
-              bit += 7;
-            }
+          pix[i] = ((sget2(bp + (bit >> 3)) >> (bit & 7) & 0x7f) << sh);
+          if (pix[i] > 0x7ff)
+            pix[i] = 0x7ff;
+          bit += 7;
         }
+    }
 
-        if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_DELTATOVALUE)
-        {
-          for (i = 0; i < 16; i++, col += 2)
-          {
-            unsigned slope =
-                pix[i] < 1001 ? 2
-                              : curve[pix[i] << 1] - curve[(pix[i] << 1) - 2];
-            unsigned step = 1 << sh;
-            RAW(row, col) =
-                curve[pix[i] << 1] >
-                        black + imgdata.rawparams.sony_arw2_posterization_thr
-                    ? LIM(((slope * step * 1000) /
-                           (curve[pix[i] << 1] - black)),
-                          0, 10000)
-                    : 0;
-          }
-        }
-        else
-          for (i = 0; i < 16; i++, col += 2)
-            RAW(row, col) = curve[pix[i] << 1];
-        col -= col & 1 ? 1 : 31;
+    if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SONYARW2_DELTATOVALUE)
+    {
+      for (i = 0; i < 16; i++, col += 2)
+      {
+        unsigned slope =
+            pix[i] < 1001 ? 2
+                          : curve[pix[i] << 1] - curve[(pix[i] << 1) - 2];
+        unsigned step = 1 << sh;
+        RAW(row, col) =
+            curve[pix[i] << 1] >
+                    black + imgdata.rawparams.sony_arw2_posterization_thr
+                ? LIM(((slope * step * 1000) /
+                       (curve[pix[i] << 1] - black)),
+                      0, 10000)
+                : 0;
+      }
+    }
+    else
+      for (i = 0; i < 16; i++, col += 2)
+        RAW(row, col) = curve[pix[i] << 1];
+    col -= col & 1 ? 1 : 31;
+  }
+}
+
+void LibRaw::sony_arw2_decode_loop(uchar *data, int row0, int nrows)
+{
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int r = 0; r < nrows; r++)
+    sony_arw2_decode_row(data + size_t(r) * raw_width, row0 + r);
+}
+
+/*
+   Every row is raw_width bytes of independent 16-pixel blocks, so rows are
+   read (or mapped) a band at a time and decoded in parallel.
+   data holds the last row of the previous band followed by the current
+   band: after a short read the missing bytes are copied from the row above,
+   exactly what the old row-by-row fread() into one buffer did.
+*/
+void LibRaw::sony_arw2_load_raw()
+{
+  const int band_rows = 256;
+  const size_t rowbytes = raw_width;
+  uchar *data = (uchar *)calloc(rowbytes * (band_rows + 1) + 1, 1);
+  uchar *band = data + rowbytes;
+  try
+  {
+    for (int row0 = 0; row0 < height; row0 += band_rows)
+    {
+      checkCancel();
+      const int nrows = MIN(band_rows, height - row0);
+      const size_t bytes = rowbytes * nrows;
+      const INT64 pos = ftell(ifp);
+      uchar *src = (uchar *)ifp->data_at(pos, bytes + 1);
+      if (src)
+      {
+        fseek(ifp, pos + INT64(bytes), SEEK_SET);
+        ifp->count_read(INT64(bytes));
+      }
+      else
+      {
+        size_t got = fread(band, 1, bytes, ifp);
+        for (size_t p = got; p < bytes; p++)
+          band[p] = data[p];
+        band[bytes] = 0;
+        src = band;
       }
+      /* decoders only read the data */
+      sony_arw2_decode_loop(src, row0, nrows);
+      memmove(data, src + bytes - rowbytes, rowbytes);
     }
   }
   catch (...)
@@ -449,150 +449,201 @@ void pana_cs6_page_decoder::read_page12()
   lastoffset += 16;
 }
 
-void LibRaw::panasonicC6_load_raw()
+void LibRaw::panasonicC6_decode_row(uchar *data, ushort *rowptr)
 {
-  const int rowstep = 16;
   const bool _12bit = libraw_internal_data.unpacker_data.pana_bpp == 12;
   const int pixperblock =  _12bit ? 14 : 11;
   const int blocksperrow = imgdata.sizes.raw_width / pixperblock;
-  const int rowbytes = blocksperrow * 16;
   const unsigned pixelbase0 = _12bit ? 0x80 : 0x200;
   const unsigned pixelbase_compare = _12bit ? 0x800 : 0x2000;
   const unsigned spix_compare = _12bit ? 0x3fff : 0xffff;
   const unsigned pixel_mask = _12bit ? 0xfff : 0x3fff;
-  std::vector<unsigned char> iobuf;
-  try
+
+  pana_cs6_page_decoder page(data, blocksperrow * 16);
+  for (int rblock = 0, col = 0; rblock < blocksperrow; rblock++)
   {
-      iobuf.resize(rowbytes * rowstep);
+      if (_12bit)
+          page.read_page12();
+      else
+          page.read_page();
+    unsigned oddeven[2] = {0, 0}, nonzero[2] = {0, 0};
+    unsigned pmul = 0, pixel_base = 0;
+    for (int pix = 0; pix < pixperblock; pix++)
+    {
+      if (pix % 3 == 2)
+      {
+        unsigned base = _12bit ? page.nextpixel12(): page.nextpixel();
+        if (base > 3)
+          throw LIBRAW_EXCEPTION_IO_CORRUPT; // not possible b/c of 2-bit
+                                             // field, but....
+        if (base == 3)
+          base = 4;
+        pixel_base = pixelbase0 << base;
+        pmul = 1 << base;
+      }
+      unsigned epixel = _12bit ? page.nextpixel12() : page.nextpixel();
+      if (oddeven[pix % 2])
+      {
+        epixel *= pmul;
+        if (pixel_base < pixelbase_compare && nonzero[pix % 2] > pixel_base)
+          epixel += nonzero[pix % 2] - pixel_base;
+        nonzero[pix % 2] = epixel;
+      }
+      else
+      {
+        oddeven[pix % 2] = epixel;
+        if (epixel)
+          nonzero[pix % 2] = epixel;
+        else
+          epixel = nonzero[pix % 2];
+      }
+      unsigned spix = epixel - 0xf;
+      if (spix <= spix_compare)
+        rowptr[col++] = spix & spix_compare;
+      else
+      {
+        epixel = (((signed int)(epixel + 0x7ffffff1)) >> 0x1f);
+        rowptr[col++] = epixel & pixel_mask;
+      }
+    }
   }
-  catch (...)
+}
+
+void LibRaw::panasonicC7_decode_row(uchar *bytes, ushort *rowptr)
+{
+  int pixperblock = libraw_internal_data.unpacker_data.pana_bpp == 14 ? 9 : 10;
+  for (int col = 0; col < imgdata.sizes.raw_width - pixperblock + 1;
+       col += pixperblock, bytes += 16)
   {
-    throw LIBRAW_EXCEPTION_ALLOC;
+    if (libraw_internal_data.unpacker_data.pana_bpp == 14)
+    {
+      rowptr[col] = bytes[0] + ((bytes[1] & 0x3F) << 8);
+      rowptr[col + 1] =
+          (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
+      rowptr[col + 2] =
+          (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
+      rowptr[col + 3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
+      rowptr[col + 4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
+      rowptr[col + 5] =
+          (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
+      rowptr[col + 6] =
+          (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
+      rowptr[col + 7] = ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
+      rowptr[col + 8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
+    }
+    else if (libraw_internal_data.unpacker_data.pana_bpp ==
+             12) // have not seen in the wild yet
+    {
+      rowptr[col] = ((bytes[1] & 0xF) << 8) + bytes[0];
+      rowptr[col + 1] = 16 * bytes[2] + (bytes[1] >> 4);
+      rowptr[col + 2] = ((bytes[4] & 0xF) << 8) + bytes[3];
+      rowptr[col + 3] = 16 * bytes[5] + (bytes[4] >> 4);
+      rowptr[col + 4] = ((bytes[7] & 0xF) << 8) + bytes[6];
+      rowptr[col + 5] = 16 * bytes[8] + (bytes[7] >> 4);
+      rowptr[col + 6] = ((bytes[10] & 0xF) << 8) + bytes[9];
+      rowptr[col + 7] = 16 * bytes[11] + (bytes[10] >> 4);
+      rowptr[col + 8] = ((bytes[13] & 0xF) << 8) + bytes[12];
+      rowptr[col + 9] = 16 * bytes[14] + (bytes[13] >> 4);
+    }
   }
+}
 
-  for (int row = 0; row < imgdata.sizes.raw_height - rowstep + 1;
-       row += rowstep)
+void LibRaw::panasonicC67_decode_loop(uchar *data, int rowbytes, int row0,
+                                      int nrows, int c7)
+{
+#ifdef LIBRAW_USE_OPENMP
+  // exception of the lowest failed row, rethrown after the loop
+  int errcnt = 0, errrow = nrows;
+  LibRaw_exceptions rowerr = LIBRAW_EXCEPTION_NONE;
+#pragma omp parallel for schedule(static) shared(errcnt, errrow, rowerr)
+#endif
+  for (int crow = 0; crow < nrows; crow++)
   {
-    int rowstoread = MIN(rowstep, imgdata.sizes.raw_height - row);
-    if (libraw_internal_data.internal_data.input->read(
-            iobuf.data(), rowbytes, rowstoread) != rowstoread)
-      throw LIBRAW_EXCEPTION_IO_EOF;
-    pana_cs6_page_decoder page(iobuf.data(), rowbytes * rowstoread);
-    for (int crow = 0, col = 0; crow < rowstoread; crow++, col = 0)
+    uchar *src = data + size_t(crow) * rowbytes;
+    ushort *rowptr = &imgdata.rawdata.raw_image[size_t(row0 + crow) *
+                                                imgdata.sizes.raw_pitch / 2];
+#ifdef LIBRAW_USE_OPENMP
+    LibRaw_exceptions err = LIBRAW_EXCEPTION_NONE;
+    try
+    {
+#endif
+      if (c7)
+        panasonicC7_decode_row(src, rowptr);
+      else
+        panasonicC6_decode_row(src, rowptr);
+#ifdef LIBRAW_USE_OPENMP
+    }
+    catch (const LibRaw_exceptions &e)
+    {
+      err = e;
+    }
+    catch (const std::bad_alloc &)
+    {
+      err = LIBRAW_EXCEPTION_ALLOC;
+    }
+    catch (...)
+    {
+      err = LIBRAW_EXCEPTION_IO_CORRUPT;
+    }
+    if (err != LIBRAW_EXCEPTION_NONE)
     {
-      unsigned short *rowptr =
-          &imgdata.rawdata
-               .raw_image[(row + crow) * imgdata.sizes.raw_pitch / 2];
-      for (int rblock = 0; rblock < blocksperrow; rblock++)
+#pragma omp critical(panasonic_c67_error)
       {
-          if (_12bit)
-              page.read_page12();
-          else
-              page.read_page();
-        unsigned oddeven[2] = {0, 0}, nonzero[2] = {0, 0};
-        unsigned pmul = 0, pixel_base = 0;
-        for (int pix = 0; pix < pixperblock; pix++)
+        errcnt++;
+        if (crow < errrow)
         {
-          if (pix % 3 == 2)
-          {
-            unsigned base = _12bit ? page.nextpixel12(): page.nextpixel();
-            if (base > 3)
-              throw LIBRAW_EXCEPTION_IO_CORRUPT; // not possible b/c of 2-bit
-                                                 // field, but....
-            if (base == 3)
-              base = 4;
-            pixel_base = pixelbase0 << base;
-            pmul = 1 << base;
-          }
-          unsigned epixel = _12bit ? page.nextpixel12() : page.nextpixel();
-          if (oddeven[pix % 2])
-          {
-            epixel *= pmul;
-            if (pixel_base < pixelbase_compare && nonzero[pix % 2] > pixel_base)
-              epixel += nonzero[pix % 2] - pixel_base;
-            nonzero[pix % 2] = epixel;
-          }
-          else
-          {
-            oddeven[pix % 2] = epixel;
-            if (epixel)
-              nonzero[pix % 2] = epixel;
-            else
-              epixel = nonzero[pix % 2];
-          }
-          unsigned spix = epixel - 0xf;
-          if (spix <= spix_compare)
-            rowptr[col++] = spix & spix_compare;
-          else
-          {
-            epixel = (((signed int)(epixel + 0x7ffffff1)) >> 0x1f);
-            rowptr[col++] = epixel & pixel_mask;
-          }
+          errrow = crow;
+          rowerr = err;
         }
       }
     }
+#endif
   }
+#ifdef LIBRAW_USE_OPENMP
+  if (errcnt)
+    throw rowerr;
+#endif
 }
 
-
-void LibRaw::panasonicC7_load_raw()
+/*
+   C6 and C7 rows are made of independent 16-byte blocks. Rows are read in
+   groups of 16 (a trailing partial group is not decoded), several groups
+   at a time, and decoded in parallel.
+*/
+void LibRaw::panasonicC67_load_raw(int c7)
 {
   const int rowstep = 16;
-  int pixperblock = libraw_internal_data.unpacker_data.pana_bpp == 14 ? 9 : 10;
-  int rowbytes = imgdata.sizes.raw_width / pixperblock * 16;
-  unsigned char *iobuf = (unsigned char *)calloc(rowbytes * rowstep,1);
-  for (int row = 0; row < imgdata.sizes.raw_height - rowstep + 1;
-       row += rowstep)
+  const int bandrows = rowstep * 16;
+  const int pixperblock =
+      c7 ? (libraw_internal_data.unpacker_data.pana_bpp == 14 ? 9 : 10)
+         : (libraw_internal_data.unpacker_data.pana_bpp == 12 ? 14 : 11);
+  const int rowbytes = imgdata.sizes.raw_width / pixperblock * 16;
+  const int rows = imgdata.sizes.raw_height / rowstep * rowstep;
+  std::vector<unsigned char> iobuf;
+  try
+  {
+      iobuf.resize(size_t(rowbytes) * MIN(bandrows, MAX(rows, 1)));
+  }
+  catch (...)
+  {
+    throw LIBRAW_EXCEPTION_ALLOC;
+  }
+
+  for (int row = 0; row < rows; row += bandrows)
   {
-    int rowstoread = MIN(rowstep, imgdata.sizes.raw_height - row);
+    checkCancel();
+    int rowstoread = MIN(bandrows, rows - row);
     if (libraw_internal_data.internal_data.input->read(
-            iobuf, rowbytes, rowstoread) != rowstoread)
+            iobuf.data(), rowbytes, rowstoread) != rowstoread)
       throw LIBRAW_EXCEPTION_IO_EOF;
-    unsigned char *bytes = iobuf;
-    for (int crow = 0; crow < rowstoread; crow++)
-    {
-      unsigned short *rowptr =
-          &imgdata.rawdata
-               .raw_image[(row + crow) * imgdata.sizes.raw_pitch / 2];
-      for (int col = 0; col < imgdata.sizes.raw_width - pixperblock + 1;
-           col += pixperblock, bytes += 16)
-      {
-        if (libraw_internal_data.unpacker_data.pana_bpp == 14)
-        {
-          rowptr[col] = bytes[0] + ((bytes[1] & 0x3F) << 8);
-          rowptr[col + 1] =
-              (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
-          rowptr[col + 2] =
-              (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
-          rowptr[col + 3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
-          rowptr[col + 4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
-          rowptr[col + 5] =
-              (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
-          rowptr[col + 6] =
-              (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
-          rowptr[col + 7] = ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
-          rowptr[col + 8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
-        }
-        else if (libraw_internal_data.unpacker_data.pana_bpp ==
-                 12) // have not seen in the wild yet
-        {
-          rowptr[col] = ((bytes[1] & 0xF) << 8) + bytes[0];
-          rowptr[col + 1] = 16 * bytes[2] + (bytes[1] >> 4);
-          rowptr[col + 2] = ((bytes[4] & 0xF) << 8) + bytes[3];
-          rowptr[col + 3] = 16 * bytes[5] + (bytes[4] >> 4);
-          rowptr[col + 4] = ((bytes[7] & 0xF) << 8) + bytes[6];
-          rowptr[col + 5] = 16 * bytes[8] + (bytes[7] >> 4);
-          rowptr[col + 6] = ((bytes[10] & 0xF) << 8) + bytes[9];
-          rowptr[col + 7] = 16 * bytes[11] + (bytes[10] >> 4);
-          rowptr[col + 8] = ((bytes[13] & 0xF) << 8) + bytes[12];
-          rowptr[col + 9] = 16 * bytes[14] + (bytes[13] >> 4);
-        }
-      }
-    }
+    panasonicC67_decode_loop(iobuf.data(), rowbytes, row, rowstoread, c7);
   }
-  free(iobuf);
 }
 
+void LibRaw::panasonicC6_load_raw() { panasonicC67_load_raw(0); }
+
+void LibRaw::panasonicC7_load_raw() { panasonicC67_load_raw(1); }
+
 void LibRaw::unpacked_load_raw_fuji_f700s20()
 {
   int base_offset = 0;
@@ -82,8 +82,9 @@ void LibRaw::packed_tiled_dng_load_raw()
 void LibRaw::sony_ljpeg_load_raw()
 {
   unsigned trow = 0, tcol = 0, jrow, jcol, row, col;
-  INT64 save;
+  INT64 save, start;
   struct jhead jh;
+  bool fast;
 
   while (trow < raw_height)
   {
@@ -91,8 +92,13 @@ void LibRaw::sony_ljpeg_load_raw()
     save = ftell(ifp); // We're at
     if (tile_length < INT_MAX)
       fseek(ifp, get4(), SEEK_SET);
+    start = ftell(ifp);
+    fast = true;
+  restart:
     if (!ljpeg_start(&jh, 0))
       break;
+    if (fast)
+      ljpeg_rows_start(&jh, start, 0); // tile size is unknown: memory-based streams only
     try
     {
       for (row = jrow = 0; jrow < (unsigned)jh.high && trow+row < raw_height-1; jrow++, row += 2)
@@ -113,6 +119,13 @@ void LibRaw::sony_ljpeg_load_raw()
       ljpeg_end(&jh);
       throw;
     }
+    if (ljpeg_rows_failed(&jh)) // fast path gave up, redo with dcraw's decoder
+    {
+      ljpeg_end(&jh);
+      fseek(ifp, start, SEEK_SET);
+      fast = false;
+      goto restart;
+    }
     fseek(ifp, save + 4, SEEK_SET);
     if ((tcol += tile_width) >= raw_width)
       trow += tile_length + (tcol = 0);
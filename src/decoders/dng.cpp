@@ -16,6 +16,7 @@
 
  */
 
+#include "../../internal/losslessjpeg.h"
 #include "../../internal/dcraw_defs.h"
 
 void LibRaw::vc5_dng_load_raw_placeholder()
@@ -53,6 +54,175 @@ void LibRaw::adobe_copy_pixel(unsigned row, unsigned col, ushort **rp)
   if (tiff_samples == 2 && shot_select)
     (*rp)--;
 }
+/*
+   Decode all tiles of a tiled lossless DNG in parallel: tile offsets and
+   sizes are read up front, each thread decodes its tile with its own
+   LibRaw_LjpegStream (tile data read with readAt() or mapped).
+   Returns 0, before any pixel is written, if the layout can't be handled
+   this way (not tiled, non-SOF3 or sRAW first tile): lossless_dng_load_raw()
+   then decodes it sequentially. A corrupted tile is reported through
+   derror(), cancel, allocation and I/O errors are rethrown.
+*/
+int LibRaw::lossless_dng_load_tiles()
+{
+  if (tile_width >= raw_width && tile_length >= raw_height)
+    return 0;
+  if (tile_width < 1 || tile_length < 1 || tiff_bps > 16)
+    return 0;
+  int iifd = find_ifd_by_offset(data_offset);
+  if (iifd < 0 || tiff_ifd[iifd].bytes < 1)
+    return 0;
+
+  const unsigned tilesH = (raw_width + tile_width - 1) / tile_width;
+  const unsigned tilesV = (raw_height + tile_length - 1) / tile_length;
+  const int tileCnt = int(tilesH * tilesV);
+  if (tileCnt < 2 || tileCnt > 1000000)
+    return 0;
+
+  const INT64 fsize = ifp->size();
+  std::vector<INT64> tOffsets(tileCnt), tBytes(tileCnt);
+  INT64 save = ftell(ifp);
+  for (int t = 0; t < tileCnt; t++)
+    tOffsets[t] = get4();
+  fseek(ifp, tiff_ifd[iifd].bytes, SEEK_SET);
+  // TileByteCounts may be SHORT or LONG
+  const bool shortBytes = tiff_ifd[iifd].bytes_type == LIBRAW_EXIFTAG_TYPE_SHORT;
+  INT64 maxBytes = 0;
+  for (int t = 0; t < tileCnt; t++)
+  {
+    tBytes[t] = shortBytes ? get2() : get4();
+    maxBytes = MAX(maxBytes, tBytes[t]);
+  }
+  fseek(ifp, save, SEEK_SET);
+  for (int t = 0; t < tileCnt; t++)
+    if (tBytes[t] < 4 || tOffsets[t] < 0 || tOffsets[t] + tBytes[t] > fsize)
+      return 0;
+  if (maxBytes > INT64(imgdata.rawparams.max_raw_memory_mb) * INT64(1024 * 1024) ||
+      maxBytes >= (1LL << 31))
+    return 0;
+
+  const bool dngbug = dng_version && dng_version < 0x1010000;
+
+  // layout check on the first tile, all tiles of an IFD share it
+  unsigned jwide0, jclrs0, rowsamples;
+  {
+    LibRaw_LjpegStream ls(ifp, tOffsets[0], unsigned(tBytes[0]), dngbug);
+    LibRaw_LjpegRowDecoder &jd = ls.rows;
+    if (!jd.valid() || jd.sraw || jd.bits > 16)
+      return 0;
+    unsigned jwide = jd.wide;
+    if (filters || colors == 1)
+      jwide *= jd.clrs;
+    if (filters && (tiff_samples == 2)) // Fuji Super CCD
+      jwide /= 2;
+    rowsamples = (tiff_samples == 1 && jd.clrs > 1 && jd.clrs * jwide == raw_width) ? jwide * jd.clrs : jwide;
+    if (rowsamples * tiff_samples > jd.wide * jd.clrs)
+      return 0; // reads past decoded row, leave it to sequential code
+    jwide0 = jd.wide;
+    jclrs0 = jd.clrs;
+  }
+
+  int badtiles = 0, failed = 0, badtile = tileCnt;
+  // exception of the lowest tile failed with other than corrupted data
+  int errtile = tileCnt;
+  LibRaw_exceptions tileerr = LIBRAW_EXCEPTION_NONE;
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel shared(badtiles, badtile, failed, errtile, tileerr)
+#endif
+  {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int t = 0; t < tileCnt; t++)
+    {
+      int stop;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic read
+#endif
+      stop = failed;
+      if (stop)
+        continue;
+      LibRaw_exceptions err = LIBRAW_EXCEPTION_NONE;
+      try
+      {
+        checkCancel();
+        LibRaw_LjpegStream ls(ifp, tOffsets[t], unsigned(tBytes[t]), dngbug);
+        LibRaw_LjpegRowDecoder &jd = ls.rows;
+        if (!jd.valid() || jd.sraw || jd.bits > 16 || jd.wide != jwide0 || jd.clrs != jclrs0)
+          throw LIBRAW_EXCEPTION_IO_CORRUPT;
+
+        const unsigned trow = (t / tilesH) * tile_length;
+        const unsigned tcol = (t % tilesH) * tile_width;
+        unsigned row = 0, col = 0;
+        for (unsigned jrow = 0; jrow < jd.high; jrow++)
+        {
+          ushort *rp = jd.next_row();
+          for (unsigned jcol = 0; jcol < rowsamples; jcol++)
+          {
+            adobe_copy_pixel(trow + row, tcol + col, &rp);
+            if (++col >= tile_width || col >= raw_width)
+              row += 1 + (col = 0);
+          }
+        }
+        if (jd.errors)
+          throw LIBRAW_EXCEPTION_IO_CORRUPT;
+      }
+      catch (const LibRaw_exceptions &e)
+      {
+        err = e;
+      }
+      catch (const std::bad_alloc &)
+      {
+        err = LIBRAW_EXCEPTION_ALLOC;
+      }
+      catch (...)
+      {
+        err = LIBRAW_EXCEPTION_IO_CORRUPT;
+      }
+      if (err == LIBRAW_EXCEPTION_IO_CORRUPT)
+      {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp critical(lossless_dng_error)
+#endif
+        {
+          badtiles++;
+          badtile = MIN(badtile, t);
+        }
+      }
+      else if (err != LIBRAW_EXCEPTION_NONE)
+      {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp critical(lossless_dng_error)
+#endif
+        {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic write
+#endif
+          failed = 1;
+          if (t < errtile)
+          {
+            errtile = t;
+            tileerr = err;
+          }
+        }
+      }
+    }
+  }
+  if (failed)
+    throw tileerr;
+  if (badtiles)
+  {
+    // same as the sequential decoder: keep what was decoded, report the
+    // position of the first corrupted tile
+    fseek(ifp, tOffsets[badtile], SEEK_SET);
+    for (int t = 0; t < badtiles; t++)
+      derror();
+    fseek(ifp, save, SEEK_SET);
+  }
+  return 1;
+}
+
 void LibRaw::lossless_dng_load_raw()
 {
   unsigned trow = 0, tcol = 0, jwide, jrow, jcol, row, col, i, j;
@@ -63,6 +233,27 @@ void LibRaw::lossless_dng_load_raw()
   int ss = shot_select;
   shot_select = libraw_internal_data.unpacker_data.dng_frames[LIM(ss,0,(LIBRAW_IFD_MAXCOUNT*2-1))] & 0xff;
 
+  if (tile_length < INT_MAX)
+  {
+    INT64 start = ftell(ifp);
+    int done;
+    try
+    {
+      done = lossless_dng_load_tiles();
+    }
+    catch (...)
+    {
+      shot_select = ss;
+      throw;
+    }
+    if (done)
+    {
+      shot_select = ss;
+      return;
+    }
+    fseek(ifp, start, SEEK_SET);
+  }
+
   while (trow < raw_height)
   {
     checkCancel();
@@ -185,6 +376,174 @@ static void jpegErrorExit_d(j_common_ptr /*cinfo*/)
   throw LIBRAW_EXCEPTION_DECODE_JPEG;
 }
 
+/*
+   Decode all tiles of a tiled lossy DNG in parallel: each thread has its
+   own jpeg_decompress_struct and reads tiles from memory (mapped stream or
+   a readAt() copy), pixels go to image[] through curves[].
+   Returns 0 if the file can't be handled this way (tile sizes unknown,
+   out of file bounds, decoding error): lossy_dng_load_raw() then decodes
+   it sequentially from scratch. Other errors (cancellation, allocation,
+   I/O) are rethrown.
+*/
+int LibRaw::lossy_dng_load_tiles(ushort (*curves)[256])
+{
+  if (tile_width >= raw_width && tile_length >= raw_height)
+    return 0;
+  if (tile_width < 1 || tile_length < 1)
+    return 0;
+  int iifd = find_ifd_by_offset(data_offset);
+  if (iifd < 0 || tiff_ifd[iifd].bytes < 1)
+    return 0;
+
+  const unsigned tilesH = (raw_width + tile_width - 1) / tile_width;
+  const unsigned tilesV = (raw_height + tile_length - 1) / tile_length;
+  const int tileCnt = int(tilesH * tilesV);
+  if (tileCnt < 2 || tileCnt > 1000000)
+    return 0;
+
+  const INT64 fsize = ifp->size();
+  std::vector<INT64> tOffsets(tileCnt), tBytes(tileCnt);
+  fseek(ifp, data_offset, SEEK_SET);
+  for (int t = 0; t < tileCnt; t++)
+    tOffsets[t] = get4();
+  fseek(ifp, tiff_ifd[iifd].bytes, SEEK_SET);
+  const bool shortBytes = tiff_ifd[iifd].bytes_type == LIBRAW_EXIFTAG_TYPE_SHORT;
+  INT64 maxBytes = 0;
+  for (int t = 0; t < tileCnt; t++)
+  {
+    tBytes[t] = shortBytes ? get2() : get4();
+    maxBytes = MAX(maxBytes, tBytes[t]);
+  }
+  for (int t = 0; t < tileCnt; t++)
+    if (tBytes[t] < 4 || tOffsets[t] < 0 || tOffsets[t] + tBytes[t] > fsize)
+      return 0;
+  if (maxBytes > INT64(imgdata.rawparams.max_raw_memory_mb) * INT64(1024 * 1024) ||
+      maxBytes >= (1LL << 31))
+    return 0;
+
+  int errcnt = 0;
+  // exception of the lowest failed tile (-1: decoder setup)
+  int errtile = tileCnt;
+  LibRaw_exceptions tileerr = LIBRAW_EXCEPTION_NONE;
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel shared(errcnt, errtile, tileerr)
+#endif
+  {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr pub;
+    cinfo.err = jpeg_std_error(&pub);
+    pub.error_exit = jpegErrorExit_d;
+    bool created = false;
+    try
+    {
+      jpeg_create_decompress(&cinfo);
+      created = true;
+    }
+    catch (...)
+    {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp critical(lossy_dng_error)
+#endif
+      {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic update
+#endif
+        errcnt++;
+        errtile = -1;
+        tileerr = LIBRAW_EXCEPTION_DECODE_JPEG;
+      }
+    }
+    std::vector<uchar> tileData; // not used for memory-mapped streams
+    std::vector<JSAMPLE> buf;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int t = 0; t < tileCnt; t++)
+    {
+      int stop;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic read
+#endif
+      stop = errcnt;
+      if (stop)
+        continue;
+      LibRaw_exceptions err = LIBRAW_EXCEPTION_NONE;
+      try
+      {
+        checkCancel();
+        const uchar *data = ifp->data_at(tOffsets[t], size_t(tBytes[t]));
+        if (!data)
+        {
+          tileData.resize(size_t(tBytes[t]));
+          if (ifp->readAt(tileData.data(), tileData.size(), tOffsets[t]) != tBytes[t])
+            throw LIBRAW_EXCEPTION_IO_EOF;
+          data = tileData.data();
+        }
+        else
+          ifp->count_read(tBytes[t]);
+        jpeg_mem_src(&cinfo, (unsigned char *)data, (unsigned long)tBytes[t]);
+        jpeg_read_header(&cinfo, TRUE);
+        jpeg_start_decompress(&cinfo);
+        if (cinfo.output_components != colors)
+          throw LIBRAW_EXCEPTION_DECODE_JPEG;
+        if (buf.size() < cinfo.output_width * cinfo.output_components)
+          buf.resize(cinfo.output_width * cinfo.output_components);
+
+        const unsigned trow = (t / tilesH) * tile_length;
+        const unsigned tcol = (t % tilesH) * tile_width;
+        JSAMPLE *buffer_array[1];
+        buffer_array[0] = buf.data();
+        unsigned row;
+        while (cinfo.output_scanline < cinfo.output_height && (row = trow + cinfo.output_scanline) < height)
+        {
+          jpeg_read_scanlines(&cinfo, buffer_array, 1);
+          for (unsigned col = 0; col < cinfo.output_width && tcol + col < width; col++)
+            for (int c = 0; c < colors; c++)
+              image[row * width + tcol + col][c] = curves[c][buf[col * colors + c]];
+        }
+      }
+      catch (const LibRaw_exceptions &e)
+      {
+        err = e;
+      }
+      catch (const std::bad_alloc &)
+      {
+        err = LIBRAW_EXCEPTION_ALLOC;
+      }
+      catch (...)
+      {
+        err = LIBRAW_EXCEPTION_DECODE_JPEG;
+      }
+      if (err != LIBRAW_EXCEPTION_NONE)
+      {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp critical(lossy_dng_error)
+#endif
+        {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic update
+#endif
+          errcnt++;
+          if (t < errtile)
+          {
+            errtile = t;
+            tileerr = err;
+          }
+        }
+      }
+      jpeg_abort_decompress(&cinfo);
+    }
+    if (created)
+      jpeg_destroy_decompress(&cinfo);
+  }
+  if (!errcnt)
+    return 1;
+  if (tileerr == LIBRAW_EXCEPTION_DECODE_JPEG || tileerr == LIBRAW_EXCEPTION_DECODE_RAW)
+    return 0;
+  throw tileerr;
+}
+
 void LibRaw::lossy_dng_load_raw()
 {
   if (!image)
@@ -235,6 +594,12 @@ void LibRaw::lossy_dng_load_raw()
     FORC4 memcpy(cur[c], curve, sizeof cur[0]);
   }
 
+  if (tile_length < INT_MAX && lossy_dng_load_tiles(cur))
+  {
+    maximum = 0xffff;
+    return;
+  }
+
   struct jpeg_error_mgr pub;
   cinfo.err = jpeg_std_error(&pub);
   pub.error_exit = jpegErrorExit_d;
@@ -14,85 +14,6 @@
 
 #include "../../internal/libraw_cxx_defs.h"
 
-inline unsigned int __DNG_HalfToFloat(ushort halfValue)
-{
-  int sign = (halfValue >> 15) & 0x00000001;
-  int exponent = (halfValue >> 10) & 0x0000001f;
-  int mantissa = halfValue & 0x000003ff;
-  if (exponent == 0)
-  {
-    if (mantissa == 0)
-    {
-      return (unsigned int)(sign << 31);
-    }
-    else
-    {
-      while (!(mantissa & 0x00000400))
-      {
-        mantissa <<= 1;
-        exponent -= 1;
-      }
-      exponent += 1;
-      mantissa &= ~0x00000400;
-    }
-  }
-  else if (exponent == 31)
-  {
-    if (mantissa == 0)
-    {
-      return (unsigned int)((sign << 31) | ((0x1eL + 127 - 15) << 23) |
-                            (0x3ffL << 13));
-    }
-    else
-    {
-      return 0;
-    }
-  }
-  exponent += (127 - 15);
-  mantissa <<= 13;
-  return (unsigned int)((sign << 31) | (exponent << 23) | mantissa);
-}
-
-inline unsigned int __DNG_FP24ToFloat(const unsigned char *input)
-{
-  int sign = (input[0] >> 7) & 0x01;
-  int exponent = (input[0]) & 0x7F;
-  int mantissa = (((int)input[1]) << 8) | input[2];
-  if (exponent == 0)
-  {
-    if (mantissa == 0)
-    {
-      return (unsigned int)(sign << 31);
-    }
-    else
-    {
-      while (!(mantissa & 0x00010000))
-      {
-        mantissa <<= 1;
-        exponent -= 1;
-      }
-      exponent += 1;
-      mantissa &= ~0x00010000;
-    }
-  }
-  else if (exponent == 127)
-  {
-    if (mantissa == 0)
-    {
-      return (unsigned int)((sign << 31) | ((0x7eL + 128 - 64) << 23) |
-                            (0xffffL << 7));
-    }
-    else
-    {
-      // Nan -- Just set to zero.
-      return 0;
-    }
-  }
-  exponent += (128 - 64);
-  mantissa <<= 7;
-  return (uint32_t)((sign << 31) | (exponent << 23) | mantissa);
-}
-
 inline void DecodeDeltaBytes(unsigned char *bytePtr, int cols, int channels)
 {
   if (channels == 1)
@@ -218,29 +139,114 @@ static void DecodeFPDelta(unsigned char *input, unsigned char *output, int cols,
 }
 #endif
 
-static float expandFloats(unsigned char *dst, int tileWidth, int bytesps)
+static inline uint32_t floatBits(float value)
 {
-  float max = 0.f;
-  if (bytesps == 2)
+  uint32_t bits;
+  memcpy(&bits, &value, 4);
+  return bits;
+}
+
+/*
+   Half (16-bit) and FP24 to float32 bits, without branches so the
+   expandFloats() loops vectorize. Denormals are converted via int->float,
+   infinities become the largest finite value of the source format and
+   NaNs become zero.
+*/
+static inline uint32_t halfToFloatBits(uint32_t half)
+{
+  uint32_t sign = (half & 0x8000) << 16;
+  uint32_t em = half & 0x7fff;
+  uint32_t denormal = floatBits(float(int(em)) * (1.f / 16777216.f)); // 2^-24
+  uint32_t normal = (em << 13) + ((127 - 15) << 23);
+  uint32_t isDenormal = 0u - uint32_t(em < 0x400);
+  uint32_t isInf = 0u - uint32_t(em == 0x7c00);
+  uint32_t isNaN = 0u - uint32_t(em > 0x7c00);
+  uint32_t bits = (denormal & isDenormal) | (normal & ~isDenormal);
+  bits = (bits & ~isInf) | ((((0x1e + 127 - 15) << 23) | (0x3ff << 13)) & isInf); // max. half value
+  return (bits | sign) & ~isNaN;                                                    // NaN: zero
+}
+
+static inline uint32_t fp24ToFloatBits(uint32_t fp24)
+{
+  uint32_t sign = (fp24 & 0x800000) << 8;
+  uint32_t em = fp24 & 0x7fffff;
+  uint32_t denormal = floatBits(float(int(em)) * (1.f / 302231454903657293676544.f)); // 2^-78
+  uint32_t normal = (em << 7) + ((128 - 64) << 23);
+  uint32_t isDenormal = 0u - uint32_t(em < 0x10000);
+  uint32_t isInf = 0u - uint32_t(em == 0x7f0000);
+  uint32_t isNaN = 0u - uint32_t(em > 0x7f0000);
+  uint32_t bits = (denormal & isDenormal) | (normal & ~isDenormal);
+  bits = (bits & ~isInf) | ((((0x7e + 128 - 64) << 23) | (0xffff << 7)) & isInf);
+  return (bits | sign) & ~isNaN;
+}
+
+/*
+   Returns max = MAX(max, values[i]) folded from the last value to the first
+   (the order of the original expandFloats() loop), values must not be NaN.
+   A nonzero maximum does not depend on the order and is found with
+   independent lanes; if signed zeros may decide, the fold is done as is.
+*/
+static float foldMaxReverse(float max, const float *values, int count)
+{
+  const int lanes = 8;
+  if (count >= lanes)
   {
-    uint16_t *dst16 = (ushort *)dst;
-    uint32_t *dst32 = (unsigned int *)dst;
-    float *f32 = (float *)dst;
-    for (int index = tileWidth - 1; index >= 0; --index)
-    {
-      dst32[index] = __DNG_HalfToFloat(dst16[index]);
-      max = MAX(max, f32[index]);
-    }
+    float lane[lanes];
+    for (int j = 0; j < lanes; j++)
+      lane[j] = values[j];
+    int i = lanes;
+    for (; i + lanes <= count; i += lanes)
+      for (int j = 0; j < lanes; j++)
+        lane[j] = MAX(lane[j], values[i + j]);
+    for (; i < count; i++)
+      lane[0] = MAX(lane[0], values[i]);
+    float blockMax = lane[0];
+    for (int j = 1; j < lanes; j++)
+      blockMax = MAX(blockMax, lane[j]);
+    if (blockMax != 0.f && blockMax > max)
+      return blockMax;
+    if (max != 0.f && blockMax < max)
+      return max;
   }
-  else if (bytesps == 3)
+  for (int i = count - 1; i >= 0; i--)
+    max = MAX(max, values[i]);
+  return max;
+}
+
+// In-place expansion of half/FP24 values to float, returns the maximum. The
+// row is converted from its end in blocks, so the wider output never
+// overwrites packed input that is still to be read.
+static float expandFloats(unsigned char *dst, int tileWidth, int bytesps)
+{
+  float max = 0.f;
+  if (bytesps == 2 || bytesps == 3)
   {
-    uint8_t *dst8 = ((unsigned char *)dst) + (tileWidth - 1) * 3;
-    uint32_t *dst32 = (unsigned int *)dst;
-    float *f32 = (float *)dst;
-    for (int index = tileWidth - 1; index >= 0; --index, dst8 -= 3)
+    const int block = 64;
+    uint32_t bits[block];
+    float values[block];
+    for (int end = tileWidth; end > 0; end -= block)
     {
-      dst32[index] = __DNG_FP24ToFloat(dst8);
-      max = MAX(max, f32[index]);
+      int start = MAX(end - block, 0);
+      int count = end - start;
+      if (bytesps == 2)
+      {
+        uint16_t packed[block];
+        memcpy(packed, dst + start * 2, count * 2);
+        for (int i = 0; i < count; i++)
+          bits[i] = halfToFloatBits(packed[i]);
+      }
+      else
+      {
+        uint8_t packed[block * 3];
+        memcpy(packed, dst + start * 3, count * 3);
+        for (int i = 0; i < count; i++)
+          bits[i] = (uint32_t(packed[i * 3]) << 16) | (uint32_t(packed[i * 3 + 1]) << 8) | packed[i * 3 + 2];
+        for (int i = 0; i < count; i++)
+          bits[i] = fp24ToFloatBits(bits[i]);
+      }
+      memcpy(dst + start * 4, bits, count * 4);
+      memcpy(values, bits, count * 4);
+      max = foldMaxReverse(max, values, count);
     }
   }
   else if (bytesps == 4)
@@ -401,46 +407,125 @@ void LibRaw::deflate_dng_load_raw()
   if (tileBytes + tileRowBytes > INT64(imgdata.rawparams.max_raw_memory_mb) * 1024LL * 1024LL)
     throw LIBRAW_EXCEPTION_TOOBIG;
 
-  std::vector<uchar> cBuffer(tiles.maxBytesInTile,0);
-  std::vector<uchar> uBuffer(tileBytes + tileRowBytes,0); // extra row for decoding
-
-  for (size_t y = 0, t = 0; y < imgdata.sizes.raw_height; y += tiles.tileHeight)
+  LibRaw_abstract_datastream *input = libraw_internal_data.internal_data.input;
+  const int bytesps = ifd->bps >> 3;
+  // per-row maxima, folded in the original tile/row order after decoding
+  std::vector<float> rowMax(size_t(tiles.tileCnt) * tiles.tileHeight, 0.f);
+  int errcnt = 0, shortreads = 0;
+  // exception of the lowest failed tile, rethrown after the loop
+  int errtile = tiles.tileCnt;
+  LibRaw_exceptions tileerr = LIBRAW_EXCEPTION_NONE;
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel shared(errcnt, shortreads, errtile, tileerr)
+#endif
+  {
+    std::vector<uchar> cBuffer; // compressed tile, not used for memory-mapped streams
+    std::vector<uchar> uBuffer; // uncompressed tile plus an extra row for decoding
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int t = 0; t < tiles.tileCnt; t++)
     {
-      for (size_t x = 0; x < imgdata.sizes.raw_width; x += tiles.tileWidth, ++t)
+      int stop;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic read
+#endif
+      stop = errcnt;
+      if (stop)
+        continue;
+      LibRaw_exceptions err = LIBRAW_EXCEPTION_NONE;
+      try
       {
-        libraw_internal_data.internal_data.input->seek(tiles.tOffsets[t], SEEK_SET);
-        int bytesread = libraw_internal_data.internal_data.input->read(cBuffer.data(), 1, tiles.tBytes[t]);
-		if (bytesread < tiles.tBytes[t])
-			derror();
-        unsigned long dstLen = tileBytes;
-        int err =
-            uncompress(uBuffer.data() + tileRowBytes, &dstLen, cBuffer.data(), (unsigned long)tiles.tBytes[t]);
-        if (err != Z_OK)
+        const uchar *cdata = input->data_at(tiles.tOffsets[t], size_t(tiles.tBytes[t]));
+        if (!cdata)
         {
-          throw LIBRAW_EXCEPTION_DECODE_RAW;
-          return;
+          cBuffer.resize(tiles.maxBytesInTile);
+          if (input->readAt(cBuffer.data(), size_t(tiles.tBytes[t]), tiles.tOffsets[t]) < tiles.tBytes[t])
+          {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+            shortreads++;
+          }
+          cdata = cBuffer.data();
         }
         else
-        {
-          int bytesps = ifd->bps >> 3;
-          size_t rowsInTile = y + tiles.tileHeight > imgdata.sizes.raw_height ? imgdata.sizes.raw_height - y : tiles.tileHeight;
-          size_t colsInTile = x + tiles.tileWidth > imgdata.sizes.raw_width ? imgdata.sizes.raw_width - x : tiles.tileWidth;
+          input->count_read(tiles.tBytes[t]);
+        uBuffer.resize(tileBytes + tileRowBytes);
+        unsigned long dstLen = tileBytes;
+        if (uncompress(uBuffer.data() + tileRowBytes, &dstLen, cdata, (unsigned long)tiles.tBytes[t]) != Z_OK)
+          throw LIBRAW_EXCEPTION_DECODE_RAW;
+
+        size_t y = size_t(t / tiles.tilesH) * tiles.tileHeight;
+        size_t x = size_t(t % tiles.tilesH) * tiles.tileWidth;
+        size_t rowsInTile =
+            y + tiles.tileHeight > imgdata.sizes.raw_height ? imgdata.sizes.raw_height - y : tiles.tileHeight;
+        size_t colsInTile =
+            x + tiles.tileWidth > imgdata.sizes.raw_width ? imgdata.sizes.raw_width - x : tiles.tileWidth;
 
-          for (size_t row = 0; row < rowsInTile; ++row) // do not process full tile if not needed
+        for (size_t row = 0; row < rowsInTile; ++row) // do not process full tile if not needed
+        {
+          unsigned char *dst = uBuffer.data() + row * tiles.tileWidth * bytesps * ifd->samples;
+          unsigned char *src = dst + tileRowBytes;
+          DecodeFPDelta(src, dst, tiles.tileWidth / xFactor, ifd->samples * xFactor, bytesps);
+          rowMax[size_t(t) * tiles.tileHeight + row] = expandFloats(dst, tiles.tileWidth * ifd->samples, bytesps);
+          unsigned char *dst2 =
+              (unsigned char *)&float_raw_image[((y + row) * imgdata.sizes.raw_width + x) * ifd->samples];
+          memmove(dst2, dst, colsInTile * ifd->samples * sizeof(float));
+        }
+      }
+      catch (const LibRaw_exceptions &e)
+      {
+        err = e;
+      }
+      catch (const std::bad_alloc &)
+      {
+        err = LIBRAW_EXCEPTION_ALLOC;
+      }
+      catch (...)
+      {
+        err = LIBRAW_EXCEPTION_DECODE_RAW;
+      }
+      if (err != LIBRAW_EXCEPTION_NONE)
+      {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp critical(deflate_dng_error)
+#endif
+        {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic update
+#endif
+          errcnt++;
+          if (t < errtile)
           {
-              unsigned char *dst = uBuffer.data() + row * tiles.tileWidth * bytesps * ifd->samples;
-              unsigned char *src = dst + tileRowBytes;
-              DecodeFPDelta(src, dst, tiles.tileWidth / xFactor, ifd->samples * xFactor, bytesps);
-              float lmax = expandFloats(dst, tiles.tileWidth * ifd->samples, bytesps);
-            max = MAX(max, lmax);
-            unsigned char *dst2 = (unsigned char *)&float_raw_image
-                [((y + row) * imgdata.sizes.raw_width + x) * ifd->samples];
-            memmove(dst2, dst, colsInTile * ifd->samples * sizeof(float));
+            errtile = t;
+            tileerr = err;
           }
         }
       }
     }
-  
+  }
+
+  if (shortreads)
+  {
+    // tile data past the end of file: same report as derror() at EOF
+    free(float_raw_image);
+    if (callbacks.data_cb)
+      (*callbacks.data_cb)(callbacks.datacb_data, input->fname(), -1);
+    throw LIBRAW_EXCEPTION_IO_EOF;
+  }
+  if (errcnt)
+  {
+    free(float_raw_image);
+    throw tileerr;
+  }
+
+  for (size_t y = 0, t = 0; y < imgdata.sizes.raw_height; y += tiles.tileHeight)
+    for (size_t x = 0; x < imgdata.sizes.raw_width && t < size_t(tiles.tileCnt); x += tiles.tileWidth, ++t)
+      for (size_t row = 0; row < tiles.tileHeight && y + row < imgdata.sizes.raw_height; ++row)
+        max = MAX(max, rowMax[t * tiles.tileHeight + row]);
+
   imgdata.color.fmaximum = max;
 
   // Set fields according to data format
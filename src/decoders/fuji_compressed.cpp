@@ -232,31 +232,20 @@ static inline void fuji_fill_buffer(fuji_compressed_block *info)
     bool needthrow = false;
     info->cur_pos = 0;
     info->cur_buf_offset += info->cur_buf_size;
-#ifdef LIBRAW_USE_OPENMP
-#pragma omp critical
-#endif
+    info->cur_buf_size =
+        (int)info->input->readAt(info->cur_buf, _min(info->max_read_size, XTRANS_BUF_SIZE), info->cur_buf_offset);
+    if (info->cur_buf_size < 1) // nothing read
     {
-#ifndef LIBRAW_USE_OPENMP
-      info->input->lock();
-#endif
-      info->input->seek(info->cur_buf_offset, SEEK_SET);
-      info->cur_buf_size = info->input->read(info->cur_buf, 1, _min(info->max_read_size, XTRANS_BUF_SIZE));
-#ifndef LIBRAW_USE_OPENMP
-      info->input->unlock();
-#endif
-      if (info->cur_buf_size < 1) // nothing read
+      if (info->fillbytes > 0)
       {
-        if (info->fillbytes > 0)
-        {
-          int ls = _max(1, _min(info->fillbytes, XTRANS_BUF_SIZE));
-          memset(info->cur_buf, 0, ls);
-          info->fillbytes -= ls;
-        }
-        else
-          needthrow = true;
+        int ls = _max(1, _min(info->fillbytes, XTRANS_BUF_SIZE));
+        memset(info->cur_buf, 0, ls);
+        info->fillbytes -= ls;
       }
-      info->max_read_size -= info->cur_buf_size;
+      else
+        needthrow = true;
     }
+    info->max_read_size -= info->cur_buf_size;
     if (needthrow)
       throw LIBRAW_EXCEPTION_IO_EOF;
   }
@@ -138,18 +138,26 @@ void LibRaw::phase_one_fix_pixel_grad(unsigned row, unsigned col)
     RAW(row, col) = constain32(total, lower, upper);
 }
 
+/*
+   The gain grid is interpolated down each cell by repeated addition, so
+   the per-row gains of a cell row are taken serially (in the same float
+   order) and the rows of the cell are then corrected in parallel.
+*/
 void LibRaw::phase_one_flat_field(int is_float, int nc)
 {
   ushort head[8];
-  unsigned wide, high, y, x, c, rend, cend, row, col;
-  float *mrow, num, mult[4];
+  unsigned wide, high, y, x, c, rend, row, row0, nrows, maxrows;
+  float *mrow, *mrows, num;
 
   read_shorts(head, 8);
   if (head[2] == 0 || head[3] == 0 || head[4] == 0 || head[5] == 0)
     return;
   wide = head[2] / head[4] + (head[2] % head[4] != 0);
   high = head[3] / head[5] + (head[3] % head[5] != 0);
-  mrow = (float *)calloc(nc * wide, sizeof *mrow);
+  /* gains of up to maxrows rows are kept for the parallel pass */
+  maxrows = MAX(1u, MIN(unsigned(head[5]), (1u << 20) / (nc * wide)));
+  mrow = (float *)calloc(nc * wide * (maxrows + 1), sizeof *mrow);
+  mrows = mrow + nc * wide;
   for (y = 0; y < high; y++)
   {
     checkCancel();
@@ -165,32 +173,51 @@ void LibRaw::phase_one_flat_field(int is_float, int nc)
     if (y == 0)
       continue;
     rend = head[1] + y * head[5];
-    for (row = rend - head[5];
-         row < raw_height && row < rend && row < unsigned(head[1] + head[3] - head[5]);
-         row++)
+    for (row0 = row = rend - head[5], nrows = 0;; row++, nrows++)
     {
-      for (x = 1; x < wide; x++)
+      const bool more = row < raw_height && row < rend &&
+                        row < unsigned(head[1] + head[3] - head[5]);
+      if (nrows == maxrows || (!more && nrows))
       {
-        for (c = 0; c < (unsigned)nc; c += 2)
-        {
-          mult[c] = mrow[c * wide + x - 1];
-          mult[c + 1] = (mrow[c * wide + x] - mult[c]) / head[4];
-        }
-        cend = head[0] + x * head[4];
-        for (col = cend - head[4];
-             col < raw_width && col < cend && col < unsigned(head[0] + head[2] - head[4]);
-             col++)
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) if (nrows > 1)
+#endif
+        for (int r = 0; r < int(nrows); r++)
         {
-          c = nc > 2 ? FC(row - top_margin, col - left_margin) : 0;
-          if (!(c & 1))
+          const unsigned frow = row0 + r;
+          const float *rmul = mrows + r * nc * wide;
+          float mult[4];
+          for (unsigned fx = 1; fx < wide; fx++)
           {
-            c = unsigned(RAW(row, col) * mult[c]);
-            RAW(row, col) = LIM(c, 0, 65535);
+            unsigned fc;
+            for (fc = 0; fc < (unsigned)nc; fc += 2)
+            {
+              mult[fc] = rmul[fc * wide + fx - 1];
+              mult[fc + 1] = (rmul[fc * wide + fx] - mult[fc]) / head[4];
+            }
+            const unsigned cend = head[0] + fx * head[4];
+            for (unsigned col = cend - head[4];
+                 col < raw_width && col < cend &&
+                 col < unsigned(head[0] + head[2] - head[4]);
+                 col++)
+            {
+              fc = nc > 2 ? FC(frow - top_margin, col - left_margin) : 0;
+              if (!(fc & 1))
+              {
+                fc = unsigned(RAW(frow, col) * mult[fc]);
+                RAW(frow, col) = LIM(fc, 0, 65535);
+              }
+              for (fc = 0; fc < (unsigned)nc; fc += 2)
+                mult[fc] += mult[fc + 1];
+            }
           }
-          for (c = 0; c < (unsigned)nc; c += 2)
-            mult[c] += mult[c + 1];
         }
+        row0 = row;
+        nrows = 0;
       }
+      if (!more)
+        break;
+      memcpy(mrows + nrows * nc * wide, mrow, nc * wide * sizeof *mrow);
       for (x = 0; x < wide; x++)
         for (c = 0; c < (unsigned)nc; c += 2)
           mrow[c * wide + x] += mrow[(c + 1) * wide + x];
@@ -199,11 +226,24 @@ void LibRaw::phase_one_flat_field(int is_float, int nc)
   free(mrow);
 }
 
+/* Applies curve[] to raw_image rows [row0,row1) x columns [col0,col1) */
+void LibRaw::phase_one_apply_curve(unsigned row0, unsigned row1, unsigned col0,
+                                   unsigned col1)
+{
+  checkCancel();
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int row = int(row0); row < int(row1); row++)
+    for (unsigned col = col0; col < col1; col++)
+      RAW(row, col) = curve[RAW(row, col)];
+}
+
 int LibRaw::phase_one_correct()
 {
   unsigned entries, tag, data, col, row, type;
   INT64 save;
-  int len, i, j, k, cip, sum;
+  int len, i, j, sum;
 #if 0
   int val[4], dev[4], max;
 #endif
@@ -212,7 +252,7 @@ int LibRaw::phase_one_correct()
   /* static */ const signed char dir[12][2] = {
       {-1, -1}, {-1, 1}, {1, -1},  {1, 1},  {-2, 0}, {0, -2},
       {0, 2},   {2, 0},  {-2, -2}, {-2, 2}, {2, -2}, {2, 2}};
-  float poly[8], num, cfrac, frac, mult[2], *yval[2] = {NULL, NULL};
+  float poly[8], num, *yval[2] = {NULL, NULL};
   ushort *xval[2];
   int qmult_applied = 0, qlin_applied = 0;
   std::vector<unsigned> badCols;
@@ -331,12 +371,8 @@ int LibRaw::phase_one_correct()
           curve[i] = ushort(LIM(num + i, 0, 65535));
         }
       apply: /* apply to whole image */
-        for (row = 0; row < raw_height; row++)
-        {
-          checkCancel();
-          for (col = (tag & 1) * ph1.split_col; col < raw_width; col++)
-            RAW(row, col) = curve[RAW(row, col)];
-        }
+        phase_one_apply_curve(0, raw_height, (tag & 1) * ph1.split_col,
+                              raw_width);
       }
       else if (tag == 0x0401)
       { /* All-color flat fields - luma calibration*/
@@ -400,14 +436,10 @@ int LibRaw::phase_one_correct()
             cf[18] = cx[18] = 65535;
             cubic_spline(cx, cf, 19);
 
-            for (row = (qr ? ph1.split_row : 0);
-                 row < unsigned(qr ? raw_height : ph1.split_row); row++)
-            {
-              checkCancel();
-              for (col = (qc ? ph1.split_col : 0);
-                   col < unsigned(qc ? raw_width : ph1.split_col); col++)
-                RAW(row, col) = curve[RAW(row, col)];
-            }
+            phase_one_apply_curve(qr ? ph1.split_row : 0,
+                                  qr ? raw_height : ph1.split_row,
+                                  qc ? ph1.split_col : 0,
+                                  qc ? raw_width : ph1.split_col);
           }
         }
         qlin_applied = 1;
@@ -434,16 +466,18 @@ int LibRaw::phase_one_correct()
         get4();
         get4();
         qmult[1][1] = 1.0f + getrealf(LIBRAW_EXIFTAG_TYPE_FLOAT);
-        for (row = 0; row < raw_height; row++)
-        {
-          checkCancel();
-          for (col = 0; col < raw_width; col++)
+        checkCancel();
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int qrow = 0; qrow < raw_height; qrow++)
+          for (unsigned qcol = 0; qcol < raw_width; qcol++)
           {
-            i = int(qmult[row >= (unsigned)ph1.split_row][col >= (unsigned)ph1.split_col] *
-                RAW(row, col));
-            RAW(row, col) = LIM(i, 0, 65535);
+            int v = int(qmult[unsigned(qrow) >= (unsigned)ph1.split_row]
+                             [qcol >= (unsigned)ph1.split_col] *
+                RAW(qrow, qcol));
+            RAW(qrow, qcol) = LIM(v, 0, 65535);
           }
-        }
         qmult_applied = 1;
       }
       else if (tag == 0x0431 && !qmult_applied && ph1.split_col > 0 && ph1.split_col < raw_width 
@@ -470,14 +504,10 @@ int LibRaw::phase_one_correct()
             cx[0] = cf[0] = 0;
             cx[8] = cf[8] = 65535;
             cubic_spline(cx, cf, 9);
-            for (row = (qr ? ph1.split_row : 0);
-                 row < unsigned(qr ? raw_height : ph1.split_row); row++)
-            {
-              checkCancel();
-              for (col = (qc ? ph1.split_col : 0);
-                   col < unsigned(qc ? raw_width : ph1.split_col); col++)
-                RAW(row, col) = curve[RAW(row, col)];
-            }
+            phase_one_apply_curve(qr ? ph1.split_row : 0,
+                                  qr ? raw_height : ph1.split_row,
+                                  qc ? ph1.split_col : 0,
+                                  qc ? raw_width : ph1.split_col);
           }
         }
         qmult_applied = 1;
@@ -492,11 +522,18 @@ int LibRaw::phase_one_correct()
       for (i = 0; i < (int)badCols.size(); ++i)
       {
         bool nextIsolated = i == ((int)(badCols.size()-1)) || badCols[i+1]>badCols[i]+4;
-        for (row = 0; row < raw_height; ++row)
-          if (prevIsolated && nextIsolated)
-            phase_one_fix_pixel_grad(row,badCols[i]);
+        const bool grad = prevIsolated && nextIsolated;
+        const unsigned bcol = badCols[i];
+        checkCancel();
+        /* the estimators never read the column being fixed */
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int brow = 0; brow < raw_height; ++brow)
+          if (grad)
+            phase_one_fix_pixel_grad(brow, bcol);
           else
-            phase_one_fix_col_pixel_avg(row,badCols[i]);
+            phase_one_fix_col_pixel_avg(brow, bcol);
         prevIsolated = nextIsolated;
       }
     }
@@ -521,34 +558,40 @@ int LibRaw::phase_one_correct()
       for (i = 0; i < 2; i++)
         for (j = 0; j < head[i + 1] * head[i + 3]; j++)
           xval[i][j] = get2();
-      for (row = 0; row < raw_height; row++)
+      checkCancel();
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (int prow = 0; prow < raw_height; prow++)
       {
-        checkCancel();
-        for (col = 0; col < raw_width; col++)
+        float mult[2] = {0.f, 0.f};
+        for (unsigned pcol = 0; pcol < raw_width; pcol++)
         {
-          cfrac = (float)col * head[3] / raw_width;
-		  cip = (int)cfrac;
+          int pi, pj, k;
+          float cfrac = (float)pcol * head[3] / raw_width;
+          const int cip = (int)cfrac;
           cfrac -= cip;
-          num = RAW(row, col) * 0.5f;
-          for (i = cip; i < cip + 2 && i < head[3]; i++)
+          const float pnum = RAW(prow, pcol) * 0.5f;
+          for (pi = cip; pi < cip + 2 && pi < head[3]; pi++)
           {
-            for (k = j = 0; j < head[1]; j++)
-              if (num < xval[0][k = head[1] * i + j])
+            float frac;
+            for (k = pj = 0; pj < head[1]; pj++)
+              if (pnum < xval[0][k = head[1] * pi + pj])
                 break;
-			if (j == 0 || j == head[1] || k < 1 || k >= w0+w1)
-				frac = 0;
-			else
-			{
-				int xdiv = (xval[0][k] - xval[0][k - 1]);
-				frac = xdiv ? (xval[0][k] - num) / (xval[0][k] - xval[0][k - 1]) : 0;
-			}
-			if (k < w0 + w1)
-				mult[i - cip] = yval[0][k > 0 ? k - 1 : 0] * frac + yval[0][k] * (1 - frac);
-			else
-				mult[i - cip] = 0;
+            if (pj == 0 || pj == head[1] || k < 1 || k >= int(w0 + w1))
+              frac = 0;
+            else
+            {
+              int xdiv = (xval[0][k] - xval[0][k - 1]);
+              frac = xdiv ? (xval[0][k] - pnum) / (xval[0][k] - xval[0][k - 1]) : 0;
+            }
+            if (k < int(w0 + w1))
+              mult[pi - cip] = yval[0][k > 0 ? k - 1 : 0] * frac + yval[0][k] * (1 - frac);
+            else
+              mult[pi - cip] = 0;
           }
-          i = int(((mult[0] * (1.f - cfrac) + mult[1] * cfrac) * row + num) * 2.f);
-          RAW(row, col) = LIM(i, 0, 65535);
+          pi = int(((mult[0] * (1.f - cfrac) + mult[1] * cfrac) * prow + pnum) * 2.f);
+          RAW(prow, pcol) = LIM(pi, 0, 65535);
         }
       }
       free(yval[0]);
@@ -638,17 +681,163 @@ unsigned LibRaw::ph1_bithuff(int nbits, ushort *huff)
 #endif
 }
 
-void LibRaw::phase_one_load_raw_c()
+/*
+   Upper bound of the bytes one phase_one_load_raw_c() row may consume:
+   per 8 pixels two length codes of up to 6 bits and eight 16-bit values,
+   16 bits for each tail pixel, plus the 32-bit refill granularity.
+*/
+static size_t ph1_c_rowbytes(int wide)
+{
+  return (size_t(wide / 8) * 140 + size_t(wide & 7) * 16 + 31) / 32 * 4 + 8;
+}
+
+/* ph1_bithuff() over an in-memory copy of one row: bytes past len read as
+   0xff, exactly as get4() does past the end of the file */
+struct ph1_row_bits
+{
+  const uchar *buf;
+  size_t len, pos;
+  short byte_order;
+  UINT64 bitbuf;
+  int vbits;
+
+  unsigned get(int nbits)
+  {
+    if (nbits == 0)
+      return 0;
+    if (vbits < nbits)
+    {
+      uchar str[4] = {0xff, 0xff, 0xff, 0xff};
+      for (int i = 0; i < 4 && pos + i < len; i++)
+        str[i] = buf[pos + i];
+      pos += 4;
+      bitbuf = bitbuf << 32 | libraw_sget4_static(byte_order, str);
+      vbits += 32;
+    }
+    unsigned c = unsigned((bitbuf << (64 - vbits) >> (64 - nbits)) & 0xffffffff);
+    vbits -= nbits;
+    return c;
+  }
+};
+
+/*
+   Per-row state of the parallel decoder. A length code of a single 1 bit
+   keeps the previous length, so the first group of a row may use the
+   lengths the row above ended with: rows are decoded assuming len_in and
+   the carried bits tell whether that guess was consumed.
+*/
+struct phase_one_row_state
+{
+  int len_in[2], len_out[2];
+  unsigned carried, errs;
+  INT64 errpos; /* stream position of the first bad prediction */
+};
+
+/*
+   Decodes one row straight into raw_image. buf is thread scratch of
+   ph1_c_rowbytes() bytes, used when the stream can't map the row.
+   Out-of-range predictions (derror() calls of the serial decoder) are
+   counted in st.errs.
+*/
+void LibRaw::phase_one_decode_row(INT64 start, int row, uchar *buf,
+                                  struct phase_one_row_state &st)
 {
   static const int length[] = {8, 7, 6, 9, 11, 10, 5, 12, 14, 13};
-  int *offset, len[2], pred[2], row, col, i, j;
-  ushort *pixel;
+  int len[2], pred[2] = {0, 0}, col, i, j;
+  const INT64 fsize = ifp->size();
+  ph1_row_bits bits;
+
+  if (start < 0)
+    start = 0;
+  bits.len = start < fsize ? size_t(MIN(INT64(ph1_c_rowbytes(raw_width)),
+                                        fsize - start))
+                           : 0;
+  bits.buf = bits.len ? ifp->data_at(start, bits.len) : NULL;
+  if (bits.buf)
+    ifp->count_read(INT64(bits.len));
+  else
+  {
+    bits.len = bits.len ? size_t(MAX(ifp->readAt(buf, bits.len, start), INT64(0))) : 0;
+    bits.buf = buf;
+  }
+  bits.pos = 0;
+  bits.byte_order = order;
+  bits.bitbuf = 0;
+  bits.vbits = 0;
+
+  len[0] = st.len_in[0];
+  len[1] = st.len_in[1];
+  st.carried = st.errs = 0;
+  ushort *dest = &RAW(row, 0);
+  for (col = 0; col < raw_width; col++)
+  {
+    ushort pixel;
+    if (col >= (raw_width & -8))
+      len[0] = len[1] = 14;
+    else if ((col & 7) == 0)
+      for (i = 0; i < 2; i++)
+      {
+        for (j = 0; j < 5 && !bits.get(1); j++)
+          ;
+        if (j--)
+          len[i] = length[j * 2 + bits.get(1)];
+        else if (!col)
+          st.carried |= 1 << i;
+      }
+    if ((i = len[col & 1]) == 14)
+      pixel = pred[col & 1] = bits.get(16);
+    else
+      pixel = pred[col & 1] += bits.get(i) + 1 - (1 << (i - 1));
+    if (pred[col & 1] >> 16)
+    {
+      if (!st.errs++)
+        st.errpos = start + INT64(bits.pos);
+    }
+    if (ph1.format == 5 && pixel < 256)
+      pixel = curve[pixel];
+    dest[col] = ph1.format == 8 ? pixel : ushort(pixel << 2);
+  }
+  st.len_out[0] = len[0];
+  st.len_out[1] = len[1];
+}
+
+void LibRaw::phase_one_decode_loop(const int *offset, int row0, int nrows,
+                                   struct phase_one_row_state *st)
+{
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<uchar> buf(ph1_c_rowbytes(raw_width));
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+    for (int r = 0; r < nrows; r++)
+    {
+      st[r].len_in[0] = st[r].len_in[1] = 14;
+      phase_one_decode_row(data_offset + offset[row0 + r], row0 + r,
+                           buf.data(), st[r]);
+    }
+  }
+}
+
+/*
+   Every row starts at its own offset from the table at strip_offset, so
+   rows are decoded in parallel with private bit readers. Rows are then
+   walked in order: the rare row that picked up the previous row's code
+   lengths is decoded again with the right ones, and errors are replayed
+   to keep derror() semantics (the first bad prediction throws if it was
+   read at end of file).
+*/
+void LibRaw::phase_one_load_raw_c()
+{
+  const int band_rows = 256;
+  int *offset, row, i;
   short(*c_black)[2], (*r_black)[2];
   if (ph1.format == 6)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
 
-  pixel = (ushort *)calloc(raw_width * 3 + raw_height * 4, 2);
-  offset = (int *)(pixel + raw_width);
+  offset = (int *)calloc(raw_height * 2 + raw_width, sizeof(int));
   fseek(ifp, strip_offset, SEEK_SET);
   for (row = 0; row < raw_height; row++)
     offset[row] = get4();
@@ -676,48 +865,49 @@ void LibRaw::phase_one_load_raw_c()
 
   for (i = 0; i < 256; i++)
     curve[i] = ushort(float(i * i) / 3.969f + 0.5f);
+  std::vector<phase_one_row_state> st(band_rows);
+  std::vector<uchar> buf(ph1_c_rowbytes(raw_width));
+  int len[2] = {14, 14};
   try
   {
-    for (row = 0; row < raw_height; row++)
+    for (row = 0; row < raw_height; row += band_rows)
     {
       checkCancel();
-      fseek(ifp, data_offset + offset[row], SEEK_SET);
-      ph1_bits(-1);
-      pred[0] = pred[1] = 0;
-      for (col = 0; col < raw_width; col++)
+      const int nrows = MIN(band_rows, raw_height - row);
+      phase_one_decode_loop(offset, row, nrows, st.data());
+      for (i = 0; i < nrows; i++)
       {
-        if (col >= (raw_width & -8))
-          len[0] = len[1] = 14;
-        else if ((col & 7) == 0)
-          for (i = 0; i < 2; i++)
-          {
-            for (j = 0; j < 5 && !ph1_bits(1); j++)
-              ;
-            if (j--)
-              len[i] = length[j * 2 + ph1_bits(1)];
-          }
-        if ((i = len[col & 1]) == 14)
-          pixel[col] = pred[col & 1] = ph1_bits(16);
-        else
-          pixel[col] = pred[col & 1] += ph1_bits(i) + 1 - (1 << (i - 1));
-        if (pred[col & 1] >> 16)
-          derror();
-        if (ph1.format == 5 && pixel[col] < 256)
-          pixel[col] = curve[pixel[col]];
+        if (((st[i].carried & 1) && st[i].len_in[0] != len[0]) ||
+            ((st[i].carried & 2) && st[i].len_in[1] != len[1]))
+        {
+          st[i].len_in[0] = len[0];
+          st[i].len_in[1] = len[1];
+          phase_one_decode_row(data_offset + offset[row + i], row + i,
+                               buf.data(), st[i]);
+        }
+        len[0] = st[i].len_out[0];
+        len[1] = st[i].len_out[1];
+        if (!st[i].errs)
+          continue;
+        if (!data_error)
+        {
+          const int at_eof = st[i].errpos >= ifp->size();
+          if (callbacks.data_cb)
+            (*callbacks.data_cb)(callbacks.datacb_data, ifp->fname(),
+                                 at_eof ? -1 : st[i].errpos);
+          if (at_eof)
+            throw LIBRAW_EXCEPTION_IO_EOF;
+        }
+        data_error += st[i].errs;
       }
-      if (ph1.format == 8)
-        memmove(&RAW(row, 0), &pixel[0], raw_width * 2);
-      else
-        for (col = 0; col < raw_width; col++)
-          RAW(row, col) = pixel[col] << 2;
     }
   }
   catch (...)
   {
-    free(pixel);
+    free(offset);
     throw;
   }
-  free(pixel);
+  free(offset);
   maximum = 0xfffc - ph1.t_black;
 }
 
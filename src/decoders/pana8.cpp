@@ -78,20 +78,10 @@ void pana8_bufio_t::refill(uint32_t newoffset)
 	if (newoffset >= begin && newoffset < end)
 		return; 
 	uint32_t readwords, remainwords,toread;
-#ifdef LIBRAW_USE_OPENMP
-#pragma omp critical
-    {
-#endif
-      input->lock();
-      input->seek(baseoffset + newoffset*sizeof(int64_t), SEEK_SET);
-      remainwords = (_size - newoffset*sizeof(int64_t) + 7) >> 3;
-      toread = MIN(PANA8_BUFSIZE, remainwords);
-      uint32_t readbytes = input->read(data.data(), 1, toread*sizeof(uint64_t));
-	  readwords = (readbytes + 7) >> 3;
-      input->unlock();
-#ifdef LIBRAW_USE_OPENMP
-    }
-#endif
+  remainwords = (_size - newoffset*sizeof(int64_t) + 7) >> 3;
+  toread = MIN(PANA8_BUFSIZE, remainwords);
+  INT64 readbytes = input->readAt(data.data(), toread*sizeof(uint64_t), baseoffset + newoffset*sizeof(int64_t));
+  readwords = readbytes > 0 ? uint32_t((readbytes + 7) >> 3) : 0;
 
   if (INT64(readwords) < INT64(toread) - 1LL)
     throw LIBRAW_EXCEPTION_IO_EOF;
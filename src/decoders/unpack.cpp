@@ -23,6 +23,7 @@ int LibRaw::unpack(void)
 {
   CHECK_ORDER_HIGH(LIBRAW_PROGRESS_LOAD_RAW);
   CHECK_ORDER_LOW(LIBRAW_PROGRESS_IDENTIFY);
+  perf_stage_begin();
   try
   {
 
@@ -138,6 +139,8 @@ int LibRaw::unpack(void)
         {
             void *_rawspeed_buffer = 0;
             try {
+                // a padded copy even for memory-backed streams (data_at()):
+                // the decoder may read up to 32 bytes past the end of data
                 ID.input->seek(0, SEEK_SET);
                 INT64 _rawspeed_buffer_sz = ID.input->size() + 32;
                 _rawspeed_buffer = malloc(_rawspeed_buffer_sz);
@@ -51,6 +51,7 @@ int LibRaw::unpack_thumb(void)
 {
   CHECK_ORDER_LOW(LIBRAW_PROGRESS_IDENTIFY);
   CHECK_ORDER_BIT(LIBRAW_PROGRESS_THUMB_LOAD);
+  perf_stage_begin();
 
 #define THUMB_SIZE_CHECKT(A) \
   do { \
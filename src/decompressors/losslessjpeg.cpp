@@ -19,6 +19,7 @@ it under the terms of the one of two licenses as you choose:
  */
 
 #include "../../internal/losslessjpeg.h"
+#include "../../internal/libraw_cxx_defs.h"
 #include <string.h>
 
 #define ZERO(a) do { memset(a,0,sizeof(a));} while(0)
@@ -36,20 +37,21 @@ bool ByteStreamBE::skip_to_marker() // true: success, false - no marker
 	return true;
 }
 
-LibRaw_LjpegDecompressor::LibRaw_LjpegDecompressor(uint8_t *b, unsigned bs, bool dngbug, bool csfix): buffer(b,bs),
-	state(State::NotInited)
+LibRaw_LjpegDecompressor::LibRaw_LjpegDecompressor(uint8_t *b, unsigned bs, bool dngbug, bool csfix,
+                                                   uint32_t minprecision): buffer(b,bs),
+	predictor(0), point_transform(0), datastart(0), restart_interval(0x7fffffff), state(State::NotInited)
 {
-	initialize(dngbug,csfix);
+	initialize(dngbug,csfix,minprecision);
 }
 
 LibRaw_LjpegDecompressor::LibRaw_LjpegDecompressor(uint8_t *b, unsigned bs): buffer(b,bs),
-	state(State::NotInited)
+	predictor(0), point_transform(0), datastart(0), restart_interval(0x7fffffff), state(State::NotInited)
 {
-	initialize(false,false);
+	initialize(false,false,12);
 }
 
 
-void LibRaw_LjpegDecompressor::initialize(bool dngbug, bool csfix)
+void LibRaw_LjpegDecompressor::initialize(bool dngbug, bool csfix, uint32_t minprecision)
 {
 	sof.csfix = csfix;
 	bool dht_init[4] = { false,false,false,false };
@@ -72,7 +74,7 @@ void LibRaw_LjpegDecompressor::initialize(bool dngbug, bool csfix)
               state = State::InvalidSOF;
               return;
 			}
-			if (sof.precision > 16 || sof.precision < 12)
+			if (sof.precision > 16 || sof.precision < minprecision)
 			{
 				state = State::IncorrectPrecision;
 				return;
@@ -107,6 +109,11 @@ void LibRaw_LjpegDecompressor::initialize(bool dngbug, bool csfix)
 			state = State::EOIReached;
 			return;
 		}
+		else if (marker == Marker::DRI)
+		{
+			buffer.get_u16();
+			restart_interval = buffer.get_u16();
+		}
 		else if (marker == Marker::DQT)
 		{
           state = State::DQTPresent;
@@ -397,3 +404,242 @@ void HuffTable::initval(uint32_t _bits[17], uint32_t _huffval[256], bool _dng_bu
 	}
     initialized = true;
 }
+
+void BitPumpLjpeg::restart()
+{
+  unsigned p = pos > 2 ? pos - 2 : 0;
+  while (p + 1 < size && !(buffer[p] == 0xff && (buffer[p + 1] & 0xf0) == 0xd0))
+    p++;
+  pos = p + 2 < size ? p + 2 : size;
+  bits = 0;
+  nbits = zbits = 0;
+  marker = false;
+}
+
+LibRaw_LjpegRowDecoder::LibRaw_LjpegRowDecoder(LibRaw_LjpegDecompressor &d, bool dngbug)
+    : wide(0), high(0), clrs(0), sraw(0), bits(0), psv(0), errors(0), dec(d),
+      pump(d.buffer.buffer, d.buffer.size, d.datastart), row(0), dng_bug(dngbug), ok(false)
+{
+  if (dec.state != LibRaw_LjpegDecompressor::State::OK || dec.dhts.size() < 4)
+    return;
+  if (dec.sof.cps < 1 || dec.sof.components.size() != dec.sof.cps)
+    return;
+  wide = dec.sof.width;
+  high = dec.sof.height;
+  sraw = (dec.sof.components[0].subsample_h * dec.sof.components[0].subsample_v - 1) & 3;
+  clrs = dec.sof.cps + sraw;
+  psv = dec.predictor;
+  if (dec.point_transform >= dec.sof.precision)
+    return;
+  bits = dec.sof.precision - dec.point_transform;
+  if (!wide || !high || clrs > 6)
+    return;
+  if (!dec.dhts[0].initialized)
+    return;
+  /* dcraw table selection: component c uses table c, or the nearest defined one below;
+     sRAW luma samples all use table 0, both chroma ones table 1 */
+  HuffTable *last = 0;
+  for (unsigned c = 0; c < 6; c++)
+  {
+    if (c < 4 && dec.dhts[c].initialized)
+      last = &dec.dhts[c];
+    huff[c] = last;
+  }
+  if (sraw)
+  {
+    HuffTable *h1 = huff[1];
+    for (unsigned c = 0; c < 4; c++)
+      huff[2 + c] = h1;
+    for (unsigned c = 0; c < sraw; c++)
+      huff[1 + c] = huff[0];
+  }
+  rows.assign(size_t(wide) * clrs * 2, 0);
+  memset(vpred, 0, sizeof(vpred));
+  ok = true;
+}
+
+int32_t LibRaw_LjpegRowDecoder::diff(HuffTable &h)
+{
+  if (!h.disable_cache)
+  {
+    uint64_t cached = h.decodecache[pump.peek(LIBRAW_DECODE_CACHE_BITS)];
+    int16_t val = int16_t(cached & 0xffff);
+    if ((cached & LIBRAW_CACHE_PRESENT_FLAG) && val != -32768)
+    {
+      pump.consume((cached >> 16) & 0xff);
+      return val;
+    }
+  }
+  uint32_t hentry = h.hufftable[pump.peek(h.nbits)];
+  pump.consume((hentry >> 16) & 0xff);
+  uint32_t len = (hentry >> 8) & 0xff;
+  if (len == 0)
+    return 0;
+  if (len == 16 && !dng_bug)
+    return -32768;
+  if (len > 16)
+  {
+    errors++;
+    return 0;
+  }
+  int32_t d = int32_t(pump.get(len));
+  if ((d & (1 << (len - 1))) == 0)
+    d -= (1 << len) - 1;
+  return d;
+}
+
+/* Same as dcraw's generic ljpeg_row() loop: luma samples after the first
+   one are predicted from the previous luma sample */
+void LibRaw_LjpegRowDecoder::decode_sraw(uint16_t *cur, const uint16_t *prev)
+{
+  int32_t spred = 0;
+  for (unsigned col = 0, i = 0; col < wide; col++)
+    for (unsigned c = 0; c < clrs; c++, i++)
+    {
+      int32_t d = diff(*huff[c]);
+      int32_t pred;
+      if (c <= sraw && (col | c))
+        pred = spred;
+      else if (col)
+        pred = cur[i - clrs];
+      else
+        pred = (vpred[c] += d) - d;
+      if (row && col)
+        switch (psv)
+        {
+        case 1:
+          break;
+        case 2:
+          pred = prev[i];
+          break;
+        case 3:
+          pred = prev[i - clrs];
+          break;
+        case 4:
+          pred = pred + prev[i] - prev[i - clrs];
+          break;
+        case 5:
+          pred = pred + ((prev[i] - prev[i - clrs]) >> 1);
+          break;
+        case 6:
+          pred = prev[i] + ((pred - prev[i - clrs]) >> 1);
+          break;
+        case 7:
+          pred = (pred + prev[i]) >> 1;
+          break;
+        default:
+          pred = 0;
+        }
+      if ((cur[i] = uint16_t(pred + d)) >> bits)
+        errors++;
+      if (c <= sraw)
+        spred = cur[i];
+    }
+}
+
+bool LibRaw_LjpegRowDecoder::narrow(unsigned w)
+{
+  if (!ok || row || !w || w > wide)
+    return false;
+  wide = w;
+  return true;
+}
+
+uint16_t *LibRaw_LjpegRowDecoder::next_row()
+{
+  if (!ok)
+    return 0;
+  if (row >= high)
+    errors++; // dcraw keeps decoding, caller will fall back to it
+  if (dec.restart_interval != 0 && (uint64_t(row) * wide) % dec.restart_interval == 0)
+  {
+    for (unsigned c = 0; c < 6; c++)
+      vpred[c] = 1 << (bits - 1);
+    if (row)
+      pump.restart();
+  }
+  const unsigned rowlen = wide * clrs;
+  uint16_t *cur = rows.data() + rowlen * (row & 1);
+  const uint16_t *prev = rows.data() + rowlen * ((row + 1) & 1);
+
+  if (sraw)
+  {
+    decode_sraw(cur, prev);
+    if (pump.underrun())
+      errors++;
+    row++;
+    return cur;
+  }
+
+  for (unsigned c = 0; c < clrs; c++)
+  {
+    int32_t d = diff(*huff[c]);
+    int32_t pred = vpred[c];
+    vpred[c] += d;
+    if ((cur[c] = uint16_t(pred + d)) >> bits)
+      errors++;
+  }
+  for (unsigned i = clrs, c = 0; i < rowlen; i++, c = (c + 1 < clrs) ? c + 1 : 0)
+  {
+    int32_t d = diff(*huff[c]);
+    int32_t pred = cur[i - clrs];
+    if (row)
+      switch (psv)
+      {
+      case 1:
+        break;
+      case 2:
+        pred = prev[i];
+        break;
+      case 3:
+        pred = prev[i - clrs];
+        break;
+      case 4:
+        pred = pred + prev[i] - prev[i - clrs];
+        break;
+      case 5:
+        pred = pred + ((prev[i] - prev[i - clrs]) >> 1);
+        break;
+      case 6:
+        pred = prev[i] + ((pred - prev[i - clrs]) >> 1);
+        break;
+      case 7:
+        pred = (pred + prev[i]) >> 1;
+        break;
+      default:
+        pred = 0;
+      }
+    if ((cur[i] = uint16_t(pred + d)) >> bits)
+      errors++;
+  }
+  if (pump.underrun())
+    errors++;
+  row++;
+  return cur;
+}
+
+uint8_t *LibRaw_LjpegStream::map(LibRaw_abstract_datastream *stream, int64_t offset, unsigned size,
+                                 std::vector<uint8_t> &storage)
+{
+  const unsigned char *mem = stream->data_at(offset, size);
+  if (mem)
+    return const_cast<uint8_t *>(mem); // never written: ByteStreamBE and BitPumpLjpeg only read
+  storage.resize(size);
+  if (stream->readAt(storage.data(), size, offset) != INT64(size))
+    throw LIBRAW_EXCEPTION_IO_EOF;
+  return storage.data();
+}
+
+// DNG tiles may use any precision dcraw's ljpeg_start() takes, not just 12..16
+LibRaw_LjpegStream::LibRaw_LjpegStream(LibRaw_abstract_datastream *stream, int64_t offset, unsigned sz,
+                                       bool dngbug)
+    : data(map(stream, offset, sz, storage)), size(sz), dec(data, size, false, false, 2), rows(dec, dngbug),
+      source(stream)
+{
+}
+
+LibRaw_LjpegStream::~LibRaw_LjpegStream()
+{
+  if (storage.empty()) // copies were counted by readAt()
+    source->count_read(INT64(rows.consumed() < size ? rows.consumed() : size));
+}
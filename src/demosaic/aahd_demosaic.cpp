@@ -43,6 +43,12 @@ struct AAHD
   char *ndir, *homo[2];
   ushort channel_maximum[3], channels_max;
   ushort channel_minimum[3];
+  /*
+   * true when every row alternates green / non-green and the neighbouring
+   * rows carry the other non-green colour, i.e. the per-row passes below do
+   * not depend on each other and may run concurrently
+   */
+  bool rows_independent;
   static const float yuv_coeff[3][3];
   static float gammaLUT[0x10000];
   float yuv_cam[3][3];
@@ -88,6 +94,8 @@ struct AAHD
   void make_ahd_rb_hv(int i);
   void make_ahd_rb_last(int i);
   void evaluate_ahd();
+  void evaluate_homo_line(int i);
+  void evaluate_dir_line(int i);
   void combine_image();
   void hide_hots();
   void refine_hv_dirs();
@@ -163,35 +171,76 @@ AAHD::AAHD(LibRaw &_libraw) : libraw(_libraw)
           0x10000 * (r < 0.0181 ? 4.5f * r : 1.0993f * pow(r, 0.45f) - .0993f);
     }
   }
-  for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
+  rows_independent = true;
+  for (int i = 0; i + 1 < libraw.imgdata.sizes.iheight; ++i)
   {
-    int col_cache[48];
-    for (int j = 0; j < 48; ++j)
+    int js = libraw.COLOR(i, 0) & 1;
+    int kc = libraw.COLOR(i, js);
+    int js1 = libraw.COLOR(i + 1, 0) & 1;
+    int kc1 = libraw.COLOR(i + 1, js1);
+    if (js1 == js || kc1 != (kc ^ 2))
     {
-      int c = libraw.COLOR(i, j);
-      if (c == 3)
-        c = 1;
-      col_cache[j] = c;
+      rows_independent = false;
+      break;
     }
-    int moff = nr_offset(i + nr_margin, nr_margin);
-    for (int j = 0; j < iwidth; ++j, ++moff)
+  }
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    ushort cmax[3], cmin[3];
+    for (int c = 0; c < 3; ++c)
     {
-      int c = col_cache[j % 48];
-      unsigned short d = libraw.imgdata.image[i * iwidth + j][c];
-      if (d != 0)
+      cmax[c] = channel_maximum[c];
+      cmin[c] = channel_minimum[c];
+    }
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
+    {
+      int col_cache[48];
+      for (int j = 0; j < 48; ++j)
       {
-        if (channel_maximum[c] < d)
-          channel_maximum[c] = d;
-        if (channel_minimum[c] > d)
-          channel_minimum[c] = d;
-        rgb_ahd[1][moff][c] = rgb_ahd[0][moff][c] = d;
+        int c = libraw.COLOR(i, j);
+        if (c == 3)
+          c = 1;
+        col_cache[j] = c;
+      }
+      int moff = nr_offset(i + nr_margin, nr_margin);
+      for (int j = 0; j < iwidth; ++j, ++moff)
+      {
+        int c = col_cache[j % 48];
+        unsigned short d = libraw.imgdata.image[i * iwidth + j][c];
+        if (d != 0)
+        {
+          if (cmax[c] < d)
+            cmax[c] = d;
+          if (cmin[c] > d)
+            cmin[c] = d;
+          rgb_ahd[1][moff][c] = rgb_ahd[0][moff][c] = d;
+        }
       }
     }
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp critical
+#endif
+    for (int c = 0; c < 3; ++c)
+    {
+      if (channel_maximum[c] < cmax[c])
+        channel_maximum[c] = cmax[c];
+      if (channel_minimum[c] > cmin[c])
+        channel_minimum[c] = cmin[c];
+    }
   }
   channels_max =
       MAX(MAX(channel_maximum[0], channel_maximum[1]), channel_maximum[2]);
 }
 
+/*
+ * hot pixels are replaced in place and the replacement is seen by the
+ * following pixels, so this pass stays sequential
+ */
 void AAHD::hide_hots()
 {
   int iwidth = libraw.imgdata.sizes.iwidth;
@@ -295,13 +344,15 @@ void AAHD::hide_hots()
 
 void AAHD::evaluate_ahd()
 {
-  int hvdir[4] = {Pw, Pe, Pn, Ps};
   /*
    * YUV
    *
    */
   for (int d = 0; d < 2; ++d)
   {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
     for (int i = 0; i < nr_width * nr_height; ++i)
     {
       ushort3 rgb;
@@ -350,128 +401,158 @@ void AAHD::evaluate_ahd()
    }
    }
    * Lab */
+  /*
+   * homo[] is accumulated by scattering into neighbours up to three rows
+   * away, so bands of 8 rows go in two sweeps (even bands, then odd ones)
+   * to keep concurrent increments apart.
+   */
+  int nbands = (libraw.imgdata.sizes.iheight + 7) / 8;
+  for (int sweep = 0; sweep < 2; ++sweep)
+  {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int b = sweep; b < nbands; b += 2)
+      for (int i = b * 8; i < MIN(b * 8 + 8, libraw.imgdata.sizes.iheight);
+           ++i)
+        evaluate_homo_line(i);
+  }
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
   for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
   {
-    int moff = nr_offset(i + nr_margin, nr_margin);
-    for (int j = 0; j < libraw.imgdata.sizes.iwidth; j++, ++moff)
+    evaluate_dir_line(i);
+  }
+}
+
+void AAHD::evaluate_homo_line(int i)
+{
+  int hvdir[4] = {Pw, Pe, Pn, Ps};
+  int moff = nr_offset(i + nr_margin, nr_margin);
+  for (int j = 0; j < libraw.imgdata.sizes.iwidth; j++, ++moff)
+  {
+    int3 *ynr;
+    float ydiff[2][4];
+    int uvdiff[2][4];
+    for (int d = 0; d < 2; ++d)
     {
-      int3 *ynr;
-      float ydiff[2][4];
-      int uvdiff[2][4];
-      for (int d = 0; d < 2; ++d)
+      ynr = &yuv[d][moff];
+      for (int k = 0; k < 4; k++)
       {
-        ynr = &yuv[d][moff];
-        for (int k = 0; k < 4; k++)
-        {
-          ydiff[d][k] = float(ABS(ynr[0][0] - ynr[hvdir[k]][0]));
-          uvdiff[d][k] = SQR(ynr[0][1] - ynr[hvdir[k]][1]) +
-                         SQR(ynr[0][2] - ynr[hvdir[k]][2]);
-        }
+        ydiff[d][k] = float(ABS(ynr[0][0] - ynr[hvdir[k]][0]));
+        uvdiff[d][k] = SQR(ynr[0][1] - ynr[hvdir[k]][1]) +
+                       SQR(ynr[0][2] - ynr[hvdir[k]][2]);
       }
-      float yeps =
-          MIN(MAX(ydiff[0][0], ydiff[0][1]), MAX(ydiff[1][2], ydiff[1][3]));
-      int uveps =
-          MIN(MAX(uvdiff[0][0], uvdiff[0][1]), MAX(uvdiff[1][2], uvdiff[1][3]));
-      for (int d = 0; d < 2; d++)
-      {
-        ynr = &yuv[d][moff];
-        for (int k = 0; k < 4; k++)
-          if (ydiff[d][k] <= yeps && uvdiff[d][k] <= uveps)
+    }
+    float yeps =
+        MIN(MAX(ydiff[0][0], ydiff[0][1]), MAX(ydiff[1][2], ydiff[1][3]));
+    int uveps =
+        MIN(MAX(uvdiff[0][0], uvdiff[0][1]), MAX(uvdiff[1][2], uvdiff[1][3]));
+    for (int d = 0; d < 2; d++)
+    {
+      ynr = &yuv[d][moff];
+      for (int k = 0; k < 4; k++)
+        if (ydiff[d][k] <= yeps && uvdiff[d][k] <= uveps)
+        {
+          homo[d][moff + hvdir[k]]++;
+          if (k / 2 == d)
           {
-            homo[d][moff + hvdir[k]]++;
-            if (k / 2 == d)
+            // если в сонаправленном направлении интеполяции следующие точки
+            // так же гомогенны, учтём их тоже
+            for (int m = 2; m < 4; ++m)
             {
-              // если в сонаправленном направлении интеполяции следующие точки
-              // так же гомогенны, учтём их тоже
-              for (int m = 2; m < 4; ++m)
+              int hvd = m * hvdir[k];
+              if (ABS(ynr[0][0] - ynr[hvd][0]) < yeps &&
+                  SQR(ynr[0][1] - ynr[hvd][1]) +
+                          SQR(ynr[0][2] - ynr[hvd][2]) <
+                      uveps)
               {
-                int hvd = m * hvdir[k];
-                if (ABS(ynr[0][0] - ynr[hvd][0]) < yeps &&
-                    SQR(ynr[0][1] - ynr[hvd][1]) +
-                            SQR(ynr[0][2] - ynr[hvd][2]) <
-                        uveps)
-                {
-                  homo[d][moff + hvd]++;
-                }
-                else
-                  break;
+                homo[d][moff + hvd]++;
               }
+              else
+                break;
             }
           }
-      }
+        }
     }
   }
-  for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
+}
+
+void AAHD::evaluate_dir_line(int i)
+{
+  int moff = nr_offset(i + nr_margin, nr_margin);
+  for (int j = 0; j < libraw.imgdata.sizes.iwidth; j++, ++moff)
   {
-    int moff = nr_offset(i + nr_margin, nr_margin);
-    for (int j = 0; j < libraw.imgdata.sizes.iwidth; j++, ++moff)
+    char hm[2];
+    for (int d = 0; d < 2; d++)
     {
-      char hm[2];
-      for (int d = 0; d < 2; d++)
-      {
-        hm[d] = 0;
-        char *hh = &homo[d][moff];
-        for (int hx = -1; hx < 2; hx++)
-          for (int hy = -1; hy < 2; hy++)
-            hm[d] += hh[nr_offset(hy, hx)];
-      }
-      char d = 0;
-      if (hm[0] != hm[1])
+      hm[d] = 0;
+      char *hh = &homo[d][moff];
+      for (int hx = -1; hx < 2; hx++)
+        for (int hy = -1; hy < 2; hy++)
+          hm[d] += hh[nr_offset(hy, hx)];
+    }
+    char d = 0;
+    if (hm[0] != hm[1])
+    {
+      if (hm[1] > hm[0])
       {
-        if (hm[1] > hm[0])
-        {
-          d = VERSH;
-        }
-        else
-        {
-          d = HORSH;
-        }
+        d = VERSH;
       }
       else
       {
-        int3 *ynr = &yuv[1][moff];
-        int gv = SQR(2 * ynr[0][0] - ynr[Pn][0] - ynr[Ps][0]);
-        gv += SQR(2 * ynr[0][1] - ynr[Pn][1] - ynr[Ps][1]) +
-              SQR(2 * ynr[0][2] - ynr[Pn][2] - ynr[Ps][2]);
-        ynr = &yuv[1][moff + Pn];
-        gv += (SQR(2 * ynr[0][0] - ynr[Pn][0] - ynr[Ps][0]) +
-               SQR(2 * ynr[0][1] - ynr[Pn][1] - ynr[Ps][1]) +
-               SQR(2 * ynr[0][2] - ynr[Pn][2] - ynr[Ps][2])) /
-              2;
-        ynr = &yuv[1][moff + Ps];
-        gv += (SQR(2 * ynr[0][0] - ynr[Pn][0] - ynr[Ps][0]) +
-               SQR(2 * ynr[0][1] - ynr[Pn][1] - ynr[Ps][1]) +
-               SQR(2 * ynr[0][2] - ynr[Pn][2] - ynr[Ps][2])) /
-              2;
-        ynr = &yuv[0][moff];
-        int gh = SQR(2 * ynr[0][0] - ynr[Pw][0] - ynr[Pe][0]);
-        gh += SQR(2 * ynr[0][1] - ynr[Pw][1] - ynr[Pe][1]) +
-              SQR(2 * ynr[0][2] - ynr[Pw][2] - ynr[Pe][2]);
-        ynr = &yuv[0][moff + Pw];
-        gh += (SQR(2 * ynr[0][0] - ynr[Pw][0] - ynr[Pe][0]) +
-               SQR(2 * ynr[0][1] - ynr[Pw][1] - ynr[Pe][1]) +
-               SQR(2 * ynr[0][2] - ynr[Pw][2] - ynr[Pe][2])) /
-              2;
-        ynr = &yuv[0][moff + Pe];
-        gh += (SQR(2 * ynr[0][0] - ynr[Pw][0] - ynr[Pe][0]) +
-               SQR(2 * ynr[0][1] - ynr[Pw][1] - ynr[Pe][1]) +
-               SQR(2 * ynr[0][2] - ynr[Pw][2] - ynr[Pe][2])) /
-              2;
-        if (gv > gh)
-          d = HOR;
-        else
-          d = VER;
+        d = HORSH;
       }
-      ndir[moff] |= d;
     }
+    else
+    {
+      int3 *ynr = &yuv[1][moff];
+      int gv = SQR(2 * ynr[0][0] - ynr[Pn][0] - ynr[Ps][0]);
+      gv += SQR(2 * ynr[0][1] - ynr[Pn][1] - ynr[Ps][1]) +
+            SQR(2 * ynr[0][2] - ynr[Pn][2] - ynr[Ps][2]);
+      ynr = &yuv[1][moff + Pn];
+      gv += (SQR(2 * ynr[0][0] - ynr[Pn][0] - ynr[Ps][0]) +
+             SQR(2 * ynr[0][1] - ynr[Pn][1] - ynr[Ps][1]) +
+             SQR(2 * ynr[0][2] - ynr[Pn][2] - ynr[Ps][2])) /
+            2;
+      ynr = &yuv[1][moff + Ps];
+      gv += (SQR(2 * ynr[0][0] - ynr[Pn][0] - ynr[Ps][0]) +
+             SQR(2 * ynr[0][1] - ynr[Pn][1] - ynr[Ps][1]) +
+             SQR(2 * ynr[0][2] - ynr[Pn][2] - ynr[Ps][2])) /
+            2;
+      ynr = &yuv[0][moff];
+      int gh = SQR(2 * ynr[0][0] - ynr[Pw][0] - ynr[Pe][0]);
+      gh += SQR(2 * ynr[0][1] - ynr[Pw][1] - ynr[Pe][1]) +
+            SQR(2 * ynr[0][2] - ynr[Pw][2] - ynr[Pe][2]);
+      ynr = &yuv[0][moff + Pw];
+      gh += (SQR(2 * ynr[0][0] - ynr[Pw][0] - ynr[Pe][0]) +
+             SQR(2 * ynr[0][1] - ynr[Pw][1] - ynr[Pe][1]) +
+             SQR(2 * ynr[0][2] - ynr[Pw][2] - ynr[Pe][2])) /
+            2;
+      ynr = &yuv[0][moff + Pe];
+      gh += (SQR(2 * ynr[0][0] - ynr[Pw][0] - ynr[Pe][0]) +
+             SQR(2 * ynr[0][1] - ynr[Pw][1] - ynr[Pe][1]) +
+             SQR(2 * ynr[0][2] - ynr[Pw][2] - ynr[Pe][2])) /
+            2;
+      if (gv > gh)
+        d = HOR;
+      else
+        d = VER;
+    }
+    ndir[moff] |= d;
   }
 }
 
 void AAHD::combine_image()
 {
-  for (int i = 0, i_out = 0; i < libraw.imgdata.sizes.iheight; ++i)
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
   {
     int moff = nr_offset(i + nr_margin, nr_margin);
+    int i_out = i * libraw.imgdata.sizes.iwidth;
     for (int j = 0; j < libraw.imgdata.sizes.iwidth; j++, ++moff, ++i_out)
     {
       if (ndir[moff] & HOT)
@@ -500,10 +581,21 @@ void AAHD::combine_image()
 
 void AAHD::refine_hv_dirs()
 {
+  /*
+   * the first two sweeps only touch one checkerboard parity at a time and
+   * read the other one; refine_ihv_dirs() sees its own updates in scan
+   * order and stays sequential
+   */
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
   for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
   {
     refine_hv_dirs(i, i & 1);
   }
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
   for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
   {
     refine_hv_dirs(i, (i & 1) ^ 1);
@@ -574,6 +666,9 @@ void AAHD::refine_hv_dirs(int i, int js)
  */
 void AAHD::make_ahd_greens()
 {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) if (rows_independent)
+#endif
   for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
   {
     make_ahd_gline(i);
@@ -693,10 +788,16 @@ void AAHD::make_ahd_rb_hv(int i)
 
 void AAHD::make_ahd_rb()
 {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) if (rows_independent)
+#endif
   for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
   {
     make_ahd_rb_hv(i);
   }
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) if (rows_independent)
+#endif
   for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
   {
     make_ahd_rb_last(i);
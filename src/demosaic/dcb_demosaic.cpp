@@ -46,6 +46,9 @@ void LibRaw::dcb_ver(float (*image3)[3])
 {
   int row, col, u = width, indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, indx) schedule(static)
+#endif
   for (row = 2; row < height - 2; row++)
     for (col = 2 + (FC(row, 2) & 1), indx = row * width + col; col < u - 2;
          col += 2, indx += 2)
@@ -60,6 +63,9 @@ void LibRaw::dcb_hor(float (*image2)[3])
 {
   int row, col, u = width, indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, indx) schedule(static)
+#endif
   for (row = 2; row < height - 2; row++)
     for (col = 2 + (FC(row, 2) & 1), indx = row * width + col; col < u - 2;
          col += 2, indx += 2)
@@ -70,10 +76,14 @@ void LibRaw::dcb_hor(float (*image2)[3])
 }
 
 // missing colors are interpolated
-void LibRaw::dcb_color()
+// serial: keep the row order for layouts where same colours touch (fbdd)
+void LibRaw::dcb_color(int serial)
 {
   int row, col, c, d, u = width, indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, indx) schedule(static) if (!serial)
+#endif
   for (row = 1; row < height - 1; row++)
     for (col = 1 + (FC(row, 1) & 1), indx = row * width + col,
         c = 2 - FC(row, col);
@@ -88,6 +98,9 @@ void LibRaw::dcb_color()
                             4.0);
     }
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, d, indx) schedule(static) if (!serial)
+#endif
   for (row = 1; row < height - 1; row++)
     for (col = 1 + (FC(row, 2) & 1), indx = row * width + col,
         c = FC(row, col + 1), d = 2 - c;
@@ -110,6 +123,9 @@ void LibRaw::dcb_color2(float (*image2)[3])
 {
   int row, col, c, d, u = width, indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, indx) schedule(static)
+#endif
   for (row = 1; row < height - 1; row++)
     for (col = 1 + (FC(row, 1) & 1), indx = row * width + col,
         c = 2 - FC(row, col);
@@ -127,6 +143,9 @@ void LibRaw::dcb_color2(float (*image2)[3])
 			  );
     }
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, d, indx) schedule(static)
+#endif
   for (row = 1; row < height - 1; row++)
     for (col = 1 + (FC(row, 2) & 1), indx = row * width + col,
         c = FC(row, col + 1), d = 2 - c;
@@ -146,6 +165,9 @@ void LibRaw::dcb_color3(float (*image3)[3])
 {
   int row, col, c, d, u = width, indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, indx) schedule(static)
+#endif
   for (row = 1; row < height - 1; row++)
     for (col = 1 + (FC(row, 1) & 1), indx = row * width + col,
         c = 2 - FC(row, col);
@@ -163,6 +185,9 @@ void LibRaw::dcb_color3(float (*image3)[3])
 			  );
     }
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, d, indx) schedule(static)
+#endif
   for (row = 1; row < height - 1; row++)
     for (col = 1 + (FC(row, 2) & 1), indx = row * width + col,
         c = FC(row, col + 1), d = 2 - c;
@@ -185,6 +210,9 @@ void LibRaw::dcb_decide(float (*image2)[3], float (*image3)[3])
   int row, col, c, d, u = width, v = 2 * u, indx;
   float current, current2, current3;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, d, indx, current, current2, current3) schedule(static)
+#endif
   for (row = 2; row < height - 2; row++)
     for (col = 2 + (FC(row, 2) & 1), indx = row * width + col, c = FC(row, col);
          col < u - 2; col += 2, indx += 2)
@@ -249,6 +277,9 @@ void LibRaw::dcb_copy_to_buffer(float (*image2)[3])
 {
   int indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(indx) schedule(static)
+#endif
   for (indx = 0; indx < height * width; indx++)
   {
     image2[indx][0] = image[indx][0]; // R
@@ -261,6 +292,9 @@ void LibRaw::dcb_restore_from_buffer(float (*image2)[3])
 {
   int indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(indx) schedule(static)
+#endif
   for (indx = 0; indx < height * width; indx++)
   {
     image[indx][0] = ushort(image2[indx][0]); // R
@@ -269,6 +303,7 @@ void LibRaw::dcb_restore_from_buffer(float (*image2)[3])
 }
 
 // R and B smoothing using green contrast, all pixels except 2 pixel wide border
+// (serial: every pixel averages already smoothed neighbours above and left)
 void LibRaw::dcb_pp()
 {
   int g1, r1, b1, u = width, indx, row, col;
@@ -299,40 +334,53 @@ void LibRaw::dcb_pp()
 }
 
 // green blurring correction, helps to get the nyquist right
+// Pixels only read same-colour neighbours two rows/columns away, so the even
+// and odd rows are independent sweeps, each kept in the serial order.
 void LibRaw::dcb_nyquist()
 {
   int row, col, c, u = width, v = 2 * u, indx;
 
-  for (row = 2; row < height - 2; row++)
-    for (col = 2 + (FC(row, 2) & 1), indx = row * width + col, c = FC(row, col);
-         col < u - 2; col += 2, indx += 2)
-    {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(row, col, c, indx) schedule(static, 1)
+#endif
+  for (int parity = 0; parity < 2; parity++)
+    for (row = 2 + parity; row < height - 2; row += 2)
+      for (col = 2 + (FC(row, 2) & 1), indx = row * width + col, c = FC(row, col);
+           col < u - 2; col += 2, indx += 2)
+      {
 
-      image[indx][1] = CLIP((image[indx + v][1] + image[indx - v][1] +
-                             image[indx - 2][1] + image[indx + 2][1]) /
-                                4.0 +
-                            image[indx][c] -
-                            (image[indx + v][c] + image[indx - v][c] +
-                             image[indx - 2][c] + image[indx + 2][c]) /
-                                4.0);
-    }
+        image[indx][1] = CLIP((image[indx + v][1] + image[indx - v][1] +
+                               image[indx - 2][1] + image[indx + 2][1]) /
+                                  4.0 +
+                              image[indx][c] -
+                              (image[indx + v][c] + image[indx - v][c] +
+                               image[indx - 2][c] + image[indx + 2][c]) /
+                                  4.0);
+      }
 }
 
 // missing colors are interpolated using high quality algorithm by Luis Sanz
 // Rodríguez
-void LibRaw::dcb_color_full()
+// serial: see dcb_color()
+void LibRaw::dcb_color_full(int serial)
 {
   int row, col, c, d, u = width, w = 3 * u, indx, g1, g2;
   float f[4], g[4], (*chroma)[2];
 
   chroma = (float(*)[2])calloc(width * height, sizeof *chroma);
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, d, indx) schedule(static) if (!serial)
+#endif
   for (row = 1; row < height - 1; row++)
     for (col = 1 + (FC(row, 1) & 1), indx = row * width + col, c = FC(row, col),
         d = c / 2;
          col < u - 1; col += 2, indx += 2)
       chroma[indx][d] = float(image[indx][c] - image[indx][1]);
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, d, indx, f, g) schedule(static) if (!serial)
+#endif
   for (row = 3; row < height - 3; row++)
     for (col = 3 + (FC(row, 1) & 1), indx = row * width + col,
         c = 1 - FC(row, col) / 2, d = 1 - c;
@@ -370,6 +418,9 @@ void LibRaw::dcb_color_full()
           (f[0] * g[0] + f[1] * g[1] + f[2] * g[2] + f[3] * g[3]) /
           (f[0] + f[1] + f[2] + f[3]);
     }
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, d, indx, f, g) schedule(static) if (!serial)
+#endif
   for (row = 3; row < height - 3; row++)
     for (col = 3 + (FC(row, 2) & 1), indx = row * width + col,
         c = FC(row, col + 1) / 2;
@@ -403,11 +454,23 @@ void LibRaw::dcb_color_full()
             (f[0] + f[1] + f[2] + f[3]);
       }
 
+  /* R and B are limited by their (partly already limited) neighbours, so
+     only the new values are computed in parallel, into chroma */
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, indx) schedule(static)
+#endif
+  for (row = 6; row < height - 6; row++)
+    for (col = 6, indx = row * width + col; col < width - 6; col++, indx++)
+    {
+      chroma[indx][0] = CLIP(chroma[indx][0] + image[indx][1]);
+      chroma[indx][1] = CLIP(chroma[indx][1] + image[indx][1]);
+    }
+
   for (row = 6; row < height - 6; row++)
     for (col = 6, indx = row * width + col; col < width - 6; col++, indx++)
     {
-      image[indx][0] = CLIP(chroma[indx][0] + image[indx][1]);
-      image[indx][2] = CLIP(chroma[indx][1] + image[indx][1]);
+      image[indx][0] = ushort(chroma[indx][0]);
+      image[indx][2] = ushort(chroma[indx][1]);
 
       g1 = MIN(
           image[indx + 1 + u][0],
@@ -460,6 +523,9 @@ void LibRaw::dcb_map()
 {
   int row, col, u = width, indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, indx) schedule(static)
+#endif
   for (row = 1; row < height - 1; row++)
   {
     for (col = 1, indx = row * width + col; col < width - 1; col++, indx++)
@@ -486,6 +552,9 @@ void LibRaw::dcb_correction()
 {
   int current, row, col, u = width, v = 2 * u, indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(current, col, indx) schedule(static)
+#endif
   for (row = 2; row < height - 2; row++)
     for (col = 2 + (FC(row, 2) & 1), indx = row * width + col; col < u - 2;
          col += 2, indx += 2)
@@ -511,6 +580,9 @@ void LibRaw::dcb_correction2()
 {
   int current, row, col, c, u = width, v = 2 * u, indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(current, col, c, indx) schedule(static)
+#endif
   for (row = 4; row < height - 4; row++)
     for (col = 4 + (FC(row, 2) & 1), indx = row * width + col, c = FC(row, col);
          col < u - 4; col += 2, indx += 2)
@@ -537,7 +609,13 @@ void LibRaw::dcb_refinement()
 {
   int row, col, c, u = width, v = 2 * u, w = 3 * u, indx, current;
   float f[5], g1, g2;
+  ushort *green = (ushort *)calloc(width * height, sizeof *green);
 
+  /* new greens are computed in parallel; the overshoot limiting below reads
+     neighbours that are already limited, so it runs in the serial order */
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, indx, current, f, g1, g2) schedule(static)
+#endif
   for (row = 4; row < height - 4; row++)
     for (col = 4 + (FC(row, 2) & 1), indx = row * width + col, c = FC(row, col);
          col < u - 4; col += 2, indx += 2)
@@ -610,12 +688,17 @@ void LibRaw::dcb_refinement()
 
         g2 = (5.f * f[0] + 3.f * f[1] + f[2] + 3.f * f[3] + f[4]) / 13.0f;
 
-        image[indx][1] = CLIP((image[indx][c]) *
-                              (current * g1 + (16 - current) * g2) / 16.0);
+        green[indx] = CLIP((image[indx][c]) *
+                           (current * g1 + (16 - current) * g2) / 16.0);
       }
       else
-        image[indx][1] = image[indx][c];
+        green[indx] = image[indx][c];
+    }
 
+  for (row = 4; row < height - 4; row++)
+    for (col = 4 + (FC(row, 2) & 1), indx = row * width + col; col < u - 4;
+         col += 2, indx += 2)
+    {
       // get rid of overshooted pixels
 
       g1 = MIN(
@@ -636,14 +719,18 @@ void LibRaw::dcb_refinement()
                           MAX(image[indx + 1][1],
                               MAX(image[indx - u][1], image[indx + u][1])))))));
 
-      image[indx][1] = ushort(ULIM(image[indx][1], g2, g1));
+      image[indx][1] = ushort(ULIM(green[indx], g2, g1));
     }
+  free(green);
 }
 
 // converts RGB to LCH colorspace and saves it to image3
 void LibRaw::rgb_to_lch(double (*image2)[3])
 {
   int indx;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(indx) schedule(static)
+#endif
   for (indx = 0; indx < height * width; indx++)
   {
 
@@ -658,6 +745,9 @@ void LibRaw::rgb_to_lch(double (*image2)[3])
 void LibRaw::lch_to_rgb(double (*image2)[3])
 {
   int indx;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(indx) schedule(static)
+#endif
   for (indx = 0; indx < height * width; indx++)
   {
 
@@ -669,11 +759,14 @@ void LibRaw::lch_to_rgb(double (*image2)[3])
   }
 }
 
-// denoising using interpolated neighbours
-void LibRaw::fbdd_correction()
+// denoising using interpolated neighbours (serial: see dcb_color())
+void LibRaw::fbdd_correction(int serial)
 {
   int row, col, c, u = width, indx;
 
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, indx) schedule(static) if (!serial)
+#endif
   for (row = 2; row < height - 2; row++)
   {
     for (col = 2, indx = row * width + col; col < width - 2; col++, indx++)
@@ -694,61 +787,96 @@ void LibRaw::fbdd_correction()
 }
 
 // corrects chroma noise
+// Pixels only read (already corrected) neighbours two rows/columns away, so
+// the four row/column parity classes are independent sweeps.
 void LibRaw::fbdd_correction2(double (*image2)[3])
 {
   int indx, v = 2 * width;
   int col, row;
   double Co, Ho, ratio;
 
-  for (row = 6; row < height - 6; row++)
-  {
-    for (col = 6; col < width - 6; col++)
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(indx, col, row, Co, Ho, ratio) schedule(static, 1)
+#endif
+  for (int parity = 0; parity < 4; parity++)
+    for (row = 6 + (parity >> 1); row < height - 6; row += 2)
     {
-      indx = row * width + col;
-
-      if (image2[indx][1] * image2[indx][2] != 0)
+      for (col = 6 + (parity & 1); col < width - 6; col += 2)
       {
-        Co = (image2[indx + v][1] + image2[indx - v][1] + image2[indx - 2][1] +
-              image2[indx + 2][1] -
-              MAX(image2[indx - 2][1],
-                  MAX(image2[indx + 2][1],
-                      MAX(image2[indx - v][1], image2[indx + v][1]))) -
-              MIN(image2[indx - 2][1],
-                  MIN(image2[indx + 2][1],
-                      MIN(image2[indx - v][1], image2[indx + v][1])))) /
-             2.0;
-        Ho = (image2[indx + v][2] + image2[indx - v][2] + image2[indx - 2][2] +
-              image2[indx + 2][2] -
-              MAX(image2[indx - 2][2],
-                  MAX(image2[indx + 2][2],
-                      MAX(image2[indx - v][2], image2[indx + v][2]))) -
-              MIN(image2[indx - 2][2],
-                  MIN(image2[indx + 2][2],
-                      MIN(image2[indx - v][2], image2[indx + v][2])))) /
-             2.0;
-        ratio = sqrt((Co * Co + Ho * Ho) / (image2[indx][1] * image2[indx][1] +
-                                            image2[indx][2] * image2[indx][2]));
-
-        if (ratio < 0.85)
+        indx = row * width + col;
+
+        if (image2[indx][1] * image2[indx][2] != 0)
         {
-          image2[indx][0] =
-              -(image2[indx][1] + image2[indx][2] - Co - Ho) + image2[indx][0];
-          image2[indx][1] = Co;
-          image2[indx][2] = Ho;
+          Co = (image2[indx + v][1] + image2[indx - v][1] + image2[indx - 2][1] +
+                image2[indx + 2][1] -
+                MAX(image2[indx - 2][1],
+                    MAX(image2[indx + 2][1],
+                        MAX(image2[indx - v][1], image2[indx + v][1]))) -
+                MIN(image2[indx - 2][1],
+                    MIN(image2[indx + 2][1],
+                        MIN(image2[indx - v][1], image2[indx + v][1])))) /
+               2.0;
+          Ho = (image2[indx + v][2] + image2[indx - v][2] + image2[indx - 2][2] +
+                image2[indx + 2][2] -
+                MAX(image2[indx - 2][2],
+                    MAX(image2[indx + 2][2],
+                        MAX(image2[indx - v][2], image2[indx + v][2]))) -
+                MIN(image2[indx - 2][2],
+                    MIN(image2[indx + 2][2],
+                        MIN(image2[indx - v][2], image2[indx + v][2])))) /
+               2.0;
+          ratio = sqrt((Co * Co + Ho * Ho) / (image2[indx][1] * image2[indx][1] +
+                                              image2[indx][2] * image2[indx][2]));
+
+          if (ratio < 0.85)
+          {
+            image2[indx][0] =
+                -(image2[indx][1] + image2[indx][2] - Co - Ho) + image2[indx][0];
+            image2[indx][1] = Co;
+            image2[indx][2] = Ho;
+          }
         }
       }
     }
-  }
+}
+
+// new green at indx limited by its eight green neighbours
+static inline ushort fbdd_green_limit(ushort (*img)[4], int indx, int u, ushort green)
+{
+  int min = MIN(
+      img[indx + 1 + u][1],
+      MIN(img[indx + 1 - u][1],
+          MIN(img[indx - 1 + u][1],
+              MIN(img[indx - 1 - u][1],
+                  MIN(img[indx - 1][1],
+                      MIN(img[indx + 1][1],
+                          MIN(img[indx - u][1], img[indx + u][1])))))));
+  int max = MAX(
+      img[indx + 1 + u][1],
+      MAX(img[indx + 1 - u][1],
+          MAX(img[indx - 1 + u][1],
+              MAX(img[indx - 1 - u][1],
+                  MAX(img[indx - 1][1],
+                      MAX(img[indx + 1][1],
+                          MAX(img[indx - u][1], img[indx + u][1])))))));
+
+  return ushort(ULIM(green, max, min));
 }
 
 // Cubic Spline Interpolation by Li and Randhawa, modified by Jacek Gozdz and
 // Luis Sanz Rodríguez
-void LibRaw::fbdd_green()
+void LibRaw::fbdd_green(int serial)
 {
-  int row, col, c, u = width, v = 2 * u, w = 3 * u, x = 4 * u, y = 5 * u, indx,
-                   min, max;
+  int row, col, c, u = width, v = 2 * u, w = 3 * u, x = 4 * u, y = 5 * u, indx;
   float f[4], g[4];
-
+  ushort *green = (ushort *)calloc(width * height, sizeof *green);
+
+  /* interpolated in parallel, limited in the serial order (see refinement).
+     With serial set (same colours touch) new greens are read by the next
+     pixels, so each one is limited right away as dcraw did */
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for default(shared) private(col, c, indx, f, g) schedule(static) if (!serial)
+#endif
   for (row = 5; row < height - 5; row++)
     for (col = 5 + (FC(row, 1) & 1), indx = row * width + col, c = FC(row, col);
          col < u - 5; col += 2, indx += 2)
@@ -784,30 +912,19 @@ void LibRaw::fbdd_green()
                    40 * (image[indx][c] - image[indx + v][c])) /
                   48.0f));
 
-      image[indx][1] =
+      green[indx] =
           CLIP((f[0] * g[0] + f[1] * g[1] + f[2] * g[2] + f[3] * g[3]) /
                (f[0] + f[1] + f[2] + f[3]));
-
-      min = MIN(
-          image[indx + 1 + u][1],
-          MIN(image[indx + 1 - u][1],
-              MIN(image[indx - 1 + u][1],
-                  MIN(image[indx - 1 - u][1],
-                      MIN(image[indx - 1][1],
-                          MIN(image[indx + 1][1],
-                              MIN(image[indx - u][1], image[indx + u][1])))))));
-
-      max = MAX(
-          image[indx + 1 + u][1],
-          MAX(image[indx + 1 - u][1],
-              MAX(image[indx - 1 + u][1],
-                  MAX(image[indx - 1 - u][1],
-                      MAX(image[indx - 1][1],
-                          MAX(image[indx + 1][1],
-                              MAX(image[indx - u][1], image[indx + u][1])))))));
-
-      image[indx][1] = ULIM(image[indx][1], max, min);
+      if (serial)
+        image[indx][1] = fbdd_green_limit(image, indx, u, green[indx]);
     }
+
+  if (!serial)
+    for (row = 5; row < height - 5; row++)
+      for (col = 5 + (FC(row, 1) & 1), indx = row * width + col; col < u - 5;
+           col += 2, indx += 2)
+        image[indx][1] = fbdd_green_limit(image, indx, u, green[indx]);
+  free(green);
 }
 
 // FBDD (Fake Before Demosaicing Denoising)
@@ -817,18 +934,24 @@ void LibRaw::fbdd(int noiserd)
   // safety net: disable for 4-color bayer or full-color images
   if (colors != 3 || !filters)
     return;
+  // same colours touch in non-Bayer layouts: the passes then read pixels
+  // written in the same pass and have to keep the serial order
+  int serial = 0;
+  for (int r = 0; r < 4; r++)
+    for (int c = 0; c < 8; c++)
+      serial |= FC(r, c) == FC(r + 1, c) || FC(r, c) == FC(r, c + 1);
   image2 = (double(*)[3])calloc(width * height, sizeof *image2);
 
   border_interpolate(4);
 
   if (noiserd > 1)
   {
-    fbdd_green();
+    fbdd_green(serial);
     // dcb_color_full(image2);
-    dcb_color_full();
-    fbdd_correction();
+    dcb_color_full(serial);
+    fbdd_correction(serial);
 
-    dcb_color();
+    dcb_color(serial);
     rgb_to_lch(image2);
     fbdd_correction2(image2);
     fbdd_correction2(image2);
@@ -836,10 +959,10 @@ void LibRaw::fbdd(int noiserd)
   }
   else
   {
-    fbdd_green();
+    fbdd_green(serial);
     // dcb_color_full(image2);
-    dcb_color_full();
-    fbdd_correction();
+    dcb_color_full(serial);
+    fbdd_correction(serial);
   }
 
   free(image2);
@@ -881,7 +1004,7 @@ void LibRaw::dcb(int iterations, int dcb_enhance)
     i++;
   }
 
-  dcb_color();
+  dcb_color(0);
   dcb_pp();
 
   dcb_map();
@@ -898,13 +1021,13 @@ void LibRaw::dcb(int iterations, int dcb_enhance)
 
   dcb_map();
   dcb_restore_from_buffer(image2);
-  dcb_color();
+  dcb_color(0);
 
   if (dcb_enhance)
   {
     dcb_refinement();
     // dcb_color_full(image2);
-    dcb_color_full();
+    dcb_color_full(0);
   }
 
   free(image2);
@@ -167,6 +167,165 @@ void LibRaw::lin_interpolate()
   RUN_CALLBACK(LIBRAW_PROGRESS_INTERPOLATE, 2, 3);
 }
 
+/* VNG-interpolates columns 2..width-3 of one row into dst */
+void LibRaw::vng_interpolate_row(int *(*code)[16], int prow, int pcol, int row,
+                                 ushort (*dst)[4])
+{
+  ushort *pix;
+  int *ip, gval[8], gmin, gmax, sum[4];
+  int col, t, color, g, diff, thold, num, c;
+
+  for (col = 2; col < width - 2; col++)
+  {
+    pix = image[row * width + col];
+    ip = code[row % prow][col % pcol];
+    memset(gval, 0, sizeof gval);
+    while ((g = ip[0]) != INT_MAX)
+    { /* Calculate gradients */
+      diff = ABS(pix[g] - pix[ip[1]]) << ip[2];
+      gval[ip[3]] += diff;
+      ip += 5;
+      if ((g = ip[-1]) == -1)
+        continue;
+      gval[g] += diff;
+      while ((g = *ip++) != -1)
+        gval[g] += diff;
+    }
+    ip++;
+    gmin = gmax = gval[0]; /* Choose a threshold */
+    for (g = 1; g < 8; g++)
+    {
+      if (gmin > gval[g])
+        gmin = gval[g];
+      if (gmax < gval[g])
+        gmax = gval[g];
+    }
+    if (gmax == 0)
+    {
+      memcpy(dst[col], pix, sizeof *image);
+      continue;
+    }
+    thold = gmin + (gmax >> 1);
+    memset(sum, 0, sizeof sum);
+    color = fcol(row, col);
+    for (num = g = 0; g < 8; g++, ip += 2)
+    { /* Average the neighbors */
+      if (gval[g] <= thold)
+      {
+        FORCC
+        if (c == color && ip[1])
+          sum[c] += (pix[c] + pix[ip[1]]) >> 1;
+        else
+          sum[c] += pix[ip[0] + c];
+        num++;
+      }
+    }
+    FORCC
+    { /* Save to buffer */
+      t = pix[color];
+      if (c != color)
+        t += (sum[c] - sum[color]) / num;
+      dst[col][c] = CLIP(t);
+    }
+  }
+}
+
+/*
+   Interpolates rows [top,bottom) with a three row window. A row is written
+   back two rows late, once nothing in the band reads it any more. The
+   first and last two rows are still read by the neighbour bands, so they
+   go to held[0..1] and held[2..3] and are stored after all bands are done.
+*/
+void LibRaw::vng_interpolate_band(int *(*code)[16], int prow, int pcol,
+                                  int top, int bottom, ushort (*brow)[4],
+                                  ushort (*held)[4])
+{
+  int row, done;
+  for (row = top; row < bottom + 2; row++)
+  {
+    if (row < bottom)
+      vng_interpolate_row(code, prow, pcol, row,
+                          brow + ((row - top) % 3) * width);
+    if ((done = row - 2) < top)
+      continue;
+    ushort(*src)[4] = brow + ((done - top) % 3) * width;
+    ushort(*dst)[4];
+    if (done < top + 2)
+      dst = held + (done - top) * width;
+    else if (done >= bottom - 2)
+      dst = held + (done - bottom + 4) * width;
+    else
+      dst = image + done * width;
+    memcpy(dst + 2, src + 2, (width - 4) * sizeof *image);
+  }
+}
+
+void LibRaw::vng_interpolate_loop(int *(*code)[16], int prow, int pcol)
+{
+  const int band_rows = 64;
+  const int bands = (height - 4 + band_rows - 1) / band_rows;
+  int terminate_flag = 0;
+  if (bands < 1 || width < 5)
+    return;
+
+#ifdef LIBRAW_USE_OPENMP
+  int buffer_count = omp_get_max_threads();
+#else
+  int buffer_count = 1;
+#endif
+  char **buffers = malloc_omp_buffers(buffer_count, width * 3 * sizeof *image);
+  ushort(*held)[4] =
+      (ushort(*)[4])calloc(size_t(bands) * 4 * width, sizeof *image);
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic) default(shared)
+#endif
+  for (int band = 0; band < bands; band++)
+  {
+#ifdef LIBRAW_USE_OPENMP
+    if (0 == omp_get_thread_num())
+#endif
+      if (callbacks.progress_cb)
+      {
+        int rr = (*callbacks.progress_cb)(callbacks.progresscb_data,
+                                          LIBRAW_PROGRESS_INTERPOLATE,
+                                          band + 1, bands);
+        if (rr)
+          terminate_flag = 1;
+      }
+    if (terminate_flag)
+      continue;
+#if defined(LIBRAW_USE_OPENMP)
+    char *buffer = buffers[omp_get_thread_num()];
+#else
+    char *buffer = buffers[0];
+#endif
+    const int top = 2 + band * band_rows;
+    vng_interpolate_band(code, prow, pcol, top,
+                         MIN(top + band_rows, height - 2),
+                         (ushort(*)[4])buffer, held + size_t(band) * 4 * width);
+  }
+
+  for (int band = 0; band < bands && !terminate_flag; band++)
+  {
+    const int top = 2 + band * band_rows;
+    const int bottom = MIN(top + band_rows, height - 2);
+    ushort(*h)[4] = held + size_t(band) * 4 * width;
+    for (int row = top; row < bottom; row++)
+      if (row < top + 2)
+        memcpy(image[row * width + 2], h[(row - top) * width + 2],
+               (width - 4) * sizeof *image);
+      else if (row >= bottom - 2)
+        memcpy(image[row * width + 2], h[(row - bottom + 4) * width + 2],
+               (width - 4) * sizeof *image);
+  }
+  free(held);
+  free_omp_buffers(buffers, buffer_count);
+
+  if (terminate_flag)
+    throw LIBRAW_EXCEPTION_CANCELLED_BY_CALLBACK;
+}
+
 /*
    This algorithm is officially called:
 
@@ -209,10 +368,9 @@ void LibRaw::vng_interpolate()
            +1, -1, +1,   +1, 0,  -120, +1, +0, +1,   +2, 0,  0x08, +1, +0, +2,
            -1, 0,  0x40, +1, +0, +2,   +1, 0,  0x10},
       chood[] = {-1, -1, -1, 0, -1, +1, 0, +1, +1, +1, +1, 0, +1, -1, 0, -1};
-  ushort(*brow[5])[4], *pix;
-  int prow = 8, pcol = 2, *ip, *code[16][16], gval[8], gmin, gmax, sum[4];
+  int prow = 8, pcol = 2, *ip, *code[16][16];
   int row, col, x, y, x1, x2, y1, y2, t, weight, grads, color, diag;
-  int g, diff, thold, num, c;
+  int g;
 
   lin_interpolate();
 
@@ -262,78 +420,7 @@ void LibRaw::vng_interpolate()
           *ip++ = 0;
       }
     }
-  brow[4] = (ushort(*)[4])calloc(width * 3, sizeof **brow);
-  for (row = 0; row < 3; row++)
-    brow[row] = brow[4] + row * width;
-  for (row = 2; row < height - 2; row++)
-  { /* Do VNG interpolation */
-    if (!((row - 2) % 256))
-      RUN_CALLBACK(LIBRAW_PROGRESS_INTERPOLATE, (row - 2) / 256 + 1,
-                   ((height - 3) / 256) + 1);
-    for (col = 2; col < width - 2; col++)
-    {
-      pix = image[row * width + col];
-      ip = code[row % prow][col % pcol];
-      memset(gval, 0, sizeof gval);
-      while ((g = ip[0]) != INT_MAX)
-      { /* Calculate gradients */
-        diff = ABS(pix[g] - pix[ip[1]]) << ip[2];
-        gval[ip[3]] += diff;
-        ip += 5;
-        if ((g = ip[-1]) == -1)
-          continue;
-        gval[g] += diff;
-        while ((g = *ip++) != -1)
-          gval[g] += diff;
-      }
-      ip++;
-      gmin = gmax = gval[0]; /* Choose a threshold */
-      for (g = 1; g < 8; g++)
-      {
-        if (gmin > gval[g])
-          gmin = gval[g];
-        if (gmax < gval[g])
-          gmax = gval[g];
-      }
-      if (gmax == 0)
-      {
-        memcpy(brow[2][col], pix, sizeof *image);
-        continue;
-      }
-      thold = gmin + (gmax >> 1);
-      memset(sum, 0, sizeof sum);
-      color = fcol(row, col);
-      for (num = g = 0; g < 8; g++, ip += 2)
-      { /* Average the neighbors */
-        if (gval[g] <= thold)
-        {
-          FORCC
-          if (c == color && ip[1])
-            sum[c] += (pix[c] + pix[ip[1]]) >> 1;
-          else
-            sum[c] += pix[ip[0] + c];
-          num++;
-        }
-      }
-      FORCC
-      { /* Save to buffer */
-        t = pix[color];
-        if (c != color)
-          t += (sum[c] - sum[color]) / num;
-        brow[2][col][c] = CLIP(t);
-      }
-    }
-    if (row > 3) /* Write buffer to image */
-      memcpy(image[(row - 2) * width + 2], brow[0] + 2,
-             (width - 4) * sizeof *image);
-    for (g = 0; g < 4; g++)
-      brow[(g - 1) & 3] = brow[g];
-  }
-  memcpy(image[(row - 2) * width + 2], brow[0] + 2,
-         (width - 4) * sizeof *image);
-  memcpy(image[(row - 1) * width + 2], brow[1] + 2,
-         (width - 4) * sizeof *image);
-  free(brow[4]);
+  vng_interpolate_loop(code, prow, pcol);
   free(code[0][0]);
 }
 
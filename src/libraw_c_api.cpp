@@ -223,6 +223,41 @@ extern "C"
     LibRaw *ip = (LibRaw *)lr->parent_class;
     ip->set_progress_handler(cb, data);
   }
+  void libraw_set_allocator(libraw_data_t *lr, const libraw_allocator_t *allocator)
+  {
+    if (!lr)
+      return;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    ip->set_allocator(allocator);
+  }
+  void libraw_set_arena_mode(libraw_data_t *lr, int enable)
+  {
+    if (!lr)
+      return;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    ip->set_arena_mode(enable);
+  }
+  void libraw_set_perf_stats(libraw_data_t *lr, int enable)
+  {
+    if (!lr)
+      return;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    ip->set_perf_stats(enable);
+  }
+  const libraw_perf_stats_t *libraw_get_perf_stats(libraw_data_t *lr)
+  {
+    if (!lr)
+      return NULL;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->get_perf_stats();
+  }
+  void libraw_reset_perf_stats(libraw_data_t *lr)
+  {
+    if (!lr)
+      return;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    ip->reset_perf_stats();
+  }
 
   int libraw_adjust_to_raw_inset_crop(libraw_data_t *lr, unsigned mask, float maxcrop)
   {
@@ -273,6 +308,15 @@ extern "C"
     LibRaw *ip = (LibRaw *)lr->parent_class;
     return ip->dcraw_make_mem_image(errc);
   }
+  int libraw_dcraw_stream_mem_image(libraw_data_t *lr,
+                                    mem_image_rows_callback cb, void *data,
+                                    int rows_per_call)
+  {
+    if (!lr)
+      return EINVAL;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->dcraw_stream_mem_image(cb, data, rows_per_call);
+  }
   libraw_processed_image_t *libraw_dcraw_make_mem_thumb(libraw_data_t *lr,
                                                         int *errc)
   {
@@ -27,6 +27,13 @@
 #include "libraw/libraw_types.h"
 #include "libraw/libraw_datastream.h"
 #include <sys/stat.h>
+#ifndef LIBRAW_WIN32_CALLS
+#include <unistd.h>
+#endif
+#ifdef LIBRAW_USE_MMAP_DATASTREAM
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
 #ifdef USE_JPEG
 #include <jpeglib.h>
 #include <jerror.h>
@@ -147,6 +154,32 @@ int LibRaw_abstract_datastream::jpeg_src(void *jpegdata)
 #endif
 }
 
+void LibRaw_abstract_datastream::count_read(INT64 bytes)
+{
+  if (bytes <= 0)
+    return;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+  _bytes_read += bytes;
+}
+
+INT64 LibRaw_abstract_datastream::readAt(void *ptr, size_t size, INT64 offset)
+{
+  INT64 ret = 0;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp critical(libraw_datastream_readat)
+#endif
+  {
+    lock();
+    INT64 savepos = tell();
+    if (!seek(offset, SEEK_SET))
+      ret = read(ptr, 1, size);
+    seek(savepos, SEEK_SET);
+    unlock();
+  }
+  return ret;
+}
 
 #ifndef LIBRAW_NO_IOSTREAMS_DATASTREAM
 // == LibRaw_file_datastream ==
@@ -230,13 +263,15 @@ int LibRaw_file_datastream::read(void *ptr, size_t size, size_t nmemb)
 /* Visual Studio 2008 marks sgetn as insecure, but VS2010 does not. */
 #if defined(WIN32SECURECALLS) && (_MSC_VER < 1600)
   LR_STREAM_CHK();
-  return int(f->_Sgetn_s(static_cast<char *>(ptr), nmemb * size, nmemb * size) /
-             (size > 0 ? size : 1));
+  std::streamsize got =
+      f->_Sgetn_s(static_cast<char *>(ptr), nmemb * size, nmemb * size);
 #else
   LR_STREAM_CHK();
-  return int(f->sgetn(static_cast<char *>(ptr), std::streamsize(nmemb * size)) /
-             (size > 0 ? size : 1));
+  std::streamsize got =
+      f->sgetn(static_cast<char *>(ptr), std::streamsize(nmemb * size));
 #endif
+  count_read(INT64(got));
+  return int(got / (size > 0 ? size : 1));
 }
 
 int LibRaw_file_datastream::eof()
@@ -338,9 +373,22 @@ int LibRaw_buffer_datastream::read(void *ptr, size_t sz, size_t nmemb)
     return 0;
   memmove(ptr, buf + streampos, to_read);
   streampos += to_read;
+  count_read(INT64(to_read));
   return int((to_read + sz - 1) / (sz > 0 ? sz : 1));
 }
 
+INT64 LibRaw_buffer_datastream::readAt(void *ptr, size_t size, INT64 offset)
+{
+  if (offset < 0 || size_t(offset) >= streamsize)
+    return 0;
+  size_t to_read = size;
+  if (to_read > streamsize - size_t(offset))
+    to_read = streamsize - size_t(offset);
+  memmove(ptr, buf + offset, to_read);
+  count_read(INT64(to_read));
+  return INT64(to_read);
+}
+
 int LibRaw_buffer_datastream::seek(INT64 o, int whence)
 {
   switch (whence)
@@ -538,7 +586,9 @@ int LibRaw_bigfile_datastream::valid() { return f ? 1 : 0; }
 int LibRaw_bigfile_datastream::read(void *ptr, size_t size, size_t nmemb)
 {
   LR_BF_CHK();
-  return int(fread(ptr, size, nmemb, f));
+  size_t got = fread(ptr, size, nmemb, f);
+  count_read(INT64(got * size));
+  return int(got);
 }
 
 int LibRaw_bigfile_datastream::eof()
@@ -579,6 +629,30 @@ INT64 LibRaw_bigfile_datastream::tell()
 #endif
 }
 
+#ifndef LIBRAW_WIN32_CALLS
+INT64 LibRaw_bigfile_datastream::readAt(void *ptr, size_t size, INT64 offset)
+{
+  LR_BF_CHK();
+  /* pread() bypasses the stdio buffer and does not move the file position */
+  int fd = fileno(f);
+  INT64 total = 0;
+  while (size > 0)
+  {
+    ssize_t r = pread(fd, ptr, size, (off_t)offset);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      break;
+    total += r;
+    offset += r;
+    size -= size_t(r);
+    ptr = (void *)((char *)ptr + r);
+  }
+  count_read(total);
+  return total;
+}
+#endif
+
 char *LibRaw_bigfile_datastream::gets(char *str, int sz)
 {
   if(sz<1) return NULL;
@@ -603,6 +677,46 @@ const char *LibRaw_bigfile_datastream::fname()
   return filename.size() > 0 ? filename.c_str() : NULL;
 }
 
+// == LibRaw_mmap_datastream
+#ifdef LIBRAW_USE_MMAP_DATASTREAM
+
+LibRaw_mmap_datastream::LibRaw_mmap_datastream(const char *fname)
+    : LibRaw_buffer_datastream(NULL, 0), filename(fname ? fname : ""),
+      pView_(NULL), cbView_(0)
+{
+  if (filename.size() < 1)
+    return;
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0 &&
+      (unsigned long long)st.st_size <= (unsigned long long)(size_t)-1)
+  {
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED)
+    {
+      pView_ = p;
+      cbView_ = st.st_size;
+    }
+  }
+  close(fd); // mapping stays valid after close
+  reconstruct_base();
+}
+
+LibRaw_mmap_datastream::~LibRaw_mmap_datastream()
+{
+  if (pView_)
+    munmap(pView_, (size_t)cbView_);
+}
+
+const char *LibRaw_mmap_datastream::fname()
+{
+  return filename.size() > 0 ? filename.c_str() : NULL;
+}
+
+#endif
+
 // == LibRaw_windows_datastream
 #ifdef LIBRAW_WIN32_CALLS
 
@@ -780,10 +894,13 @@ INT64 LibRaw_bigfile_buffered_datastream::readAt(void *ptr, size_t size, INT64 o
     memset(&olap, 0, sizeof(olap));
     olap.Offset = off & 0xffffffff;
     olap.OffsetHigh = off >> 32;
-	if (ReadFile(fhandle, ptr, nNumberOfBytesToRead, &NumberOfBytesRead, &olap))
-		return NumberOfBytesRead;
-	else if (NumberOfBytesRead > 0)
+	/* buffer refills go through here too, so this counts file reads */
+	if (ReadFile(fhandle, ptr, nNumberOfBytesToRead, &NumberOfBytesRead, &olap) ||
+	    NumberOfBytesRead > 0)
+	{
+		count_read(NumberOfBytesRead);
 		return NumberOfBytesRead;
+	}
 	else
         return 0;
 }
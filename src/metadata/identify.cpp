@@ -18,6 +18,8 @@
 
 #include "../../internal/dcraw_defs.h"
 #include "../../internal/libraw_cameraids.h"
+#include <vector>
+#include <algorithm>
 
 // clang-format on
 static const struct
@@ -107,26 +109,75 @@ static const struct
 };
 // clang-format on
 
+/*
+   CorpTable names by maker index (first entry wins), built on first use
+ */
+static const char *corp_name(unsigned maker)
+{
+  static const struct corp_index_t
+  {
+    const char *name[LIBRAW_CAMERAMAKER_TheLastOne];
+    corp_index_t()
+    {
+      memset(name, 0, sizeof(name));
+      for (int i = int(sizeof CorpTable / sizeof *CorpTable) - 1; i >= 0; i--)
+        if ((unsigned)CorpTable[i].CorpId < LIBRAW_CAMERAMAKER_TheLastOne)
+          name[CorpTable[i].CorpId] = CorpTable[i].CorpName;
+    }
+  } corp_index;
+  return maker < LIBRAW_CAMERAMAKER_TheLastOne ? corp_index.name[maker] : 0;
+}
+
+/*
+   Built-in fsize-identified cameras ordered by file size (table order kept
+   among equal sizes), so identify() can binary search instead of scanning
+ */
+struct fsize_index_t
+{
+  std::vector<const libraw_custom_camera_t *> byfsize;
+
+  static bool less(const libraw_custom_camera_t *a,
+                   const libraw_custom_camera_t *b)
+  {
+    return a->fsize < b->fsize;
+  }
+
+  fsize_index_t(const libraw_custom_camera_t *table, unsigned count)
+  {
+    for (unsigned i = 0; i < count; i++)
+      byfsize.push_back(table + i);
+    std::stable_sort(byfsize.begin(), byfsize.end(), less);
+  }
+
+  const libraw_custom_camera_t *find(INT64 fsize) const
+  {
+    if (fsize < 0 || fsize > 0xffffffffLL)
+      return 0;
+    libraw_custom_camera_t key;
+    key.fsize = (unsigned)fsize;
+    std::vector<const libraw_custom_camera_t *>::const_iterator it =
+        std::lower_bound(byfsize.begin(), byfsize.end(), &key, less);
+    return it != byfsize.end() && (*it)->fsize == key.fsize ? *it : 0;
+  }
+};
+
 int LibRaw::setMakeFromIndex(unsigned makei)
 {
 	if (makei <= LIBRAW_CAMERAMAKER_Unknown || makei >= LIBRAW_CAMERAMAKER_TheLastOne) return 0;
 
-	for (int i = 0; i < int(sizeof CorpTable / sizeof *CorpTable); i++)
-		if ((unsigned)CorpTable[i].CorpId == makei)
-		{
-			strcpy(normalized_make, CorpTable[i].CorpName);
-			maker_index = makei;
-			return 1;
-		}
+	const char *name = corp_name(makei);
+	if (name)
+	{
+		strcpy(normalized_make, name);
+		maker_index = makei;
+		return 1;
+	}
 	return 0;
 }
 
 const char *LibRaw::cameramakeridx2maker(unsigned maker)
 {
-    for (int i = 0; i < int(sizeof CorpTable / sizeof *CorpTable); i++)
-        if((unsigned)CorpTable[i].CorpId == maker)
-            return CorpTable[i].CorpName;
-    return 0;
+    return corp_name(maker);
 }
 
 int LibRaw::simplify_make_model(unsigned *_maker_index, 
@@ -158,14 +209,10 @@ int LibRaw::simplify_make_model(unsigned *_maker_index,
       mkindex = LIBRAW_CAMERAMAKER_Pentax;
     }
 
-  for (int i = 0; i < int(sizeof CorpTable / sizeof *CorpTable); i++)
+  if (const char *name = corp_name(mkindex))
     {
-      if (mkindex == (unsigned)CorpTable[i].CorpId)
-      {
-        strncpy(_make, CorpTable[i].CorpName, _make_buf_size - 1);
-        _make[_make_buf_size - 1] = 0;
-        break;
-      }
+      strncpy(_make, name, _make_buf_size - 1);
+      _make[_make_buf_size - 1] = 0;
     }
 
     char *cp = 0;
@@ -436,8 +483,9 @@ void LibRaw::identify()
 	  {  2818048, 1376, 1024,   0,  0,  1,  0, 97, 0x49, 0, 0, "Sony", "XCD-SX910CR" },
   };
 
-  libraw_custom_camera_t
-      table[64 + sizeof(const_table) / sizeof(const_table[0])];
+  static const fsize_index_t fsize_index(
+      const_table, sizeof(const_table) / sizeof(const_table[0]));
+  libraw_custom_camera_t table[64];
 
 
   // clang-format on
@@ -449,9 +497,6 @@ void LibRaw::identify()
 
   unsigned camera_count =
       parse_custom_cameras(64, table, imgdata.rawparams.custom_camera_strings);
-  for (int q = 0; q < int(sizeof(const_table) / sizeof(const_table[0])); q++)
-    memmove(&table[q + camera_count], &const_table[q], sizeof(const_table[0]));
-  camera_count += sizeof(const_table) / sizeof(const_table[0]);
 
   tiff_flip = flip = filters = UINT_MAX; /* unknown */
   raw_height = raw_width = fuji_width = fuji_layout = cr2_slice[0] = 0;
@@ -734,63 +779,71 @@ void LibRaw::identify()
   }
 
   if (make[0] == 0)
-    for (zero_fsize = i = 0; i < (int)camera_count; i++)
+  {
+    /* custom cameras take precedence over the built-in list */
+    const libraw_custom_camera_t *cam = 0;
+    for (i = 0; i < (int)camera_count && !cam; i++)
       if (fsize == (INT64)table[i].fsize)
+        cam = &table[i];
+    if (!cam)
+      cam = fsize_index.find(fsize);
+    zero_fsize = 0;
+    if (cam)
+    {
+      strcpy(make, cam->t_make);
+      strcpy(model, cam->t_model);
+      flip = cam->flags >> 2;
+      zero_is_bad = cam->flags & 2;
+      data_offset = cam->offset == 0xffff ? 0 : cam->offset;
+      raw_width = cam->rw;
+      raw_height = cam->rh;
+      left_margin = cam->lm;
+      top_margin = cam->tm;
+      width = raw_width - left_margin - cam->rm;
+      height = raw_height - top_margin - cam->bm;
+      filters = 0x1010101U * cam->cf;
+      colors = 4 - !((filters & filters >> 1) & 0x5555);
+      load_flags = cam->lf & 0xff;
+      if (cam->lf & 0x100) /* Monochrome sensor dump */
+      {
+        colors = 1;
+        filters = 0;
+      }
+      switch (tiff_bps = unsigned((fsize - data_offset) * 8LL / (INT64(raw_width) * INT64(raw_height))))
       {
-        strcpy(make, table[i].t_make);
-        strcpy(model, table[i].t_model);
-        flip = table[i].flags >> 2;
-        zero_is_bad = table[i].flags & 2;
-        data_offset = table[i].offset == 0xffff ? 0 : table[i].offset;
-        raw_width = table[i].rw;
-        raw_height = table[i].rh;
-        left_margin = table[i].lm;
-        top_margin = table[i].tm;
-        width = raw_width - left_margin - table[i].rm;
-        height = raw_height - top_margin - table[i].bm;
-        filters = 0x1010101U * table[i].cf;
-        colors = 4 - !((filters & filters >> 1) & 0x5555);
-        load_flags = table[i].lf & 0xff;
-        if (table[i].lf & 0x100) /* Monochrome sensor dump */
+      case 6:
+        load_raw = &LibRaw::minolta_rd175_load_raw;
+        ilm.CameraMount = LIBRAW_MOUNT_Minolta_A;
+        break;
+      case 8:
+        load_raw = &LibRaw::eight_bit_load_raw;
+        break;
+      case 10:
+        if ((fsize - data_offset) / INT64(raw_height) * 3LL >= INT64(raw_width) * 4LL)
         {
-          colors = 1;
-          filters = 0;
+          load_raw = &LibRaw::android_loose_load_raw;
+          break;
         }
-        switch (tiff_bps = unsigned((fsize - data_offset) * 8LL / (INT64(raw_width) * INT64(raw_height))))
+        else if (load_flags & 1)
         {
-        case 6:
-          load_raw = &LibRaw::minolta_rd175_load_raw;
-          ilm.CameraMount = LIBRAW_MOUNT_Minolta_A;
-          break;
-        case 8:
-          load_raw = &LibRaw::eight_bit_load_raw;
+          load_raw = &LibRaw::android_tight_load_raw;
           break;
-        case 10:
-          if ((fsize - data_offset) / INT64(raw_height) * 3LL >= INT64(raw_width) * 4LL)
-          {
-            load_raw = &LibRaw::android_loose_load_raw;
-            break;
-          }
-          else if (load_flags & 1)
-          {
-            load_raw = &LibRaw::android_tight_load_raw;
-            break;
-          }
-        case 12:
-          load_flags |= 128;
-          load_raw = &LibRaw::packed_load_raw;
-          break;
-        case 16:
-          order = 0x4949 | 0x404 * (load_flags & 1);
-          tiff_bps -= load_flags >> 4;
-          tiff_bps -= load_flags = load_flags >> 1 & 7;
-          load_raw = table[i].offset == 0xffff
-                         ? &LibRaw::unpacked_load_raw_reversed
-                         : &LibRaw::unpacked_load_raw;
         }
-        maximum = (1 << tiff_bps) - (1 << table[i].max);
+      case 12:
+        load_flags |= 128;
+        load_raw = &LibRaw::packed_load_raw;
         break;
+      case 16:
+        order = 0x4949 | 0x404 * (load_flags & 1);
+        tiff_bps -= load_flags >> 4;
+        tiff_bps -= load_flags = load_flags >> 1 & 7;
+        load_raw = cam->offset == 0xffff
+                       ? &LibRaw::unpacked_load_raw_reversed
+                       : &LibRaw::unpacked_load_raw;
       }
+      maximum = (1 << tiff_bps) - (1 << cam->max);
+    }
+  }
   if (zero_fsize)
     fsize = 0;
   if (make[0] == 0 && fsize < 25000000LL)
@@ -689,6 +689,7 @@ int LibRaw::parse_tiff_ifd(INT64 base)
       break;
     case 0x0145: // 325
       tiff_ifd[ifd].bytes = len > 1 ? ftell(ifp) : get4(); // FIXME: get8 for BigTIFF
+      tiff_ifd[ifd].bytes_type = type;
       break;
     case 0x014a: /* 330, SubIFDs */
       if (!strcmp(model, "DSLR-A100") && tiff_ifd[ifd].t_width == 3872)
@@ -74,9 +74,12 @@ void LibRaw::fuji_rotate()
 
 void LibRaw::stretch()
 {
-  ushort newdim, (*img)[4], *pix0, *pix1;
+  ushort newdim, *img, *pix0, *pix1;
   int row, col, c;
   double rc, frac;
+  // image[][4] or packed imgdata.rgb_image[][3]
+  const int ps = imgdata.rgb_image ? 3 : 4;
+  ushort *src = imgdata.rgb_image ? imgdata.rgb_image[0] : image[0];
 
   if (pixel_aspect == 1)
     return;
@@ -88,18 +91,18 @@ void LibRaw::stretch()
       return;
     newdim = ushort(height / pixel_aspect + 0.5);
     /* SECURITY FIX: Check for integer overflow in allocation */
-    size_t stretch_alloc = safe_alloc_size_2d(width, newdim, sizeof *img);
+    size_t stretch_alloc = safe_alloc_size_2d(width, newdim, ps * sizeof *img);
     if (stretch_alloc == 0)
       throw LIBRAW_EXCEPTION_ALLOC;
-    img = (ushort(*)[4])calloc(width, newdim * sizeof *img);
+    img = (ushort *)calloc(width, newdim * ps * sizeof *img);
     for (rc = row = 0; row < newdim; row++, rc += pixel_aspect)
     {
       frac = int(rc - double(c = int(rc)));
-      pix0 = pix1 = image[c * width];
+      pix0 = pix1 = src + size_t(c) * width * ps;
       if (c + 1 < height)
-        pix1 += width * 4;
-      for (col = 0; col < width; col++, pix0 += 4, pix1 += 4)
-        FORCC img[row * width + col][c] =
+        pix1 += width * ps;
+      for (col = 0; col < width; col++, pix0 += ps, pix1 += ps)
+        FORCC img[(row * width + col) * ps + c] =
             ushort(pix0[c] * (1 - frac) + pix1[c] * frac + 0.5);
     }
     height = newdim;
@@ -108,23 +111,26 @@ void LibRaw::stretch()
   {
     newdim = ushort(width * pixel_aspect + 0.5);
     /* SECURITY FIX: Check for integer overflow in allocation */
-    size_t stretch_alloc2 = safe_alloc_size_2d(height, newdim, sizeof *img);
+    size_t stretch_alloc2 = safe_alloc_size_2d(height, newdim, ps * sizeof *img);
     if (stretch_alloc2 == 0)
       throw LIBRAW_EXCEPTION_ALLOC;
-    img = (ushort(*)[4])calloc(height, newdim * sizeof *img);
+    img = (ushort *)calloc(height, newdim * ps * sizeof *img);
     for (rc = col = 0; col < newdim; col++, rc += 1 / pixel_aspect)
     {
       frac = int(rc - double(c = int(rc)));
-      pix0 = pix1 = image[c];
+      pix0 = pix1 = src + size_t(c) * ps;
       if (c + 1 < width)
-        pix1 += 4;
-      for (row = 0; row < height; row++, pix0 += width * 4, pix1 += width * 4)
-        FORCC img[row * newdim + col][c] =
+        pix1 += ps;
+      for (row = 0; row < height; row++, pix0 += width * ps, pix1 += width * ps)
+        FORCC img[(row * newdim + col) * ps + c] =
             ushort(pix0[c] * (1 - frac) + pix1[c] * frac + 0.5);
     }
     width = newdim;
   }
-  free(image);
-  image = img;
+  free(src);
+  if (imgdata.rgb_image)
+    imgdata.rgb_image = (ushort(*)[3])img;
+  else
+    image = (ushort(*)[4])img;
   RUN_CALLBACK(LIBRAW_PROGRESS_STRETCH, 1, 2);
 }
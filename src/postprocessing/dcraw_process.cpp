@@ -24,6 +24,7 @@ int LibRaw::dcraw_process(void)
 
   CHECK_ORDER_LOW(LIBRAW_PROGRESS_LOAD_RAW);
   //    CHECK_ORDER_HIGH(LIBRAW_PROGRESS_PRE_INTERPOLATE);
+  perf_stage_begin();
 
   try
   {
@@ -44,7 +45,14 @@ int LibRaw::dcraw_process(void)
     int subtract_inline =
         !O.bad_pixels && !O.dark_frame && is_bayer && !IO.zero_is_bad;
 
-    int rc = raw2image_ex(subtract_inline); // allocate imgdata.image and copy data!
+    // Black subtraction, adjust_maximum() and scale_colors() may be done in
+    // the same pass as the copy if nothing has to see the data in between
+    int scaled = subtract_inline && !O.no_auto_scale && !P1.is_foveon &&
+                 !callbacks.pre_subtractblack_cb &&
+                 !callbacks.pre_scalecolors_cb && !O.threshold &&
+                 !(O.green_matching && !O.half_size) && !scale_colors_auto_wb();
+
+    int rc = raw2image_ex_internal(subtract_inline, &scaled); // allocate imgdata.image and copy data!
 	if (rc != LIBRAW_SUCCESS)
 		return rc;
 
@@ -80,17 +88,20 @@ int LibRaw::dcraw_process(void)
     if (O.user_qual >= 0)
       quality = O.user_qual;
 
-    if (!subtract_inline || !C.data_maximum)
+    if (!scaled)
     {
-      adjust_bl();
-      subtract_black_internal();
-    }
+      if (!subtract_inline || !C.data_maximum)
+      {
+        adjust_bl();
+        subtract_black_internal();
+      }
 
-    if (!(di.decoder_flags & LIBRAW_DECODER_FIXEDMAXC))
-      adjust_maximum();
+      if (!(di.decoder_flags & LIBRAW_DECODER_FIXEDMAXC))
+        adjust_maximum();
 
-    if (O.user_sat > 0)
-      C.maximum = O.user_sat;
+      if (O.user_sat > 0)
+        C.maximum = O.user_sat;
+    }
 
     if (P1.is_foveon)
     {
@@ -115,7 +126,9 @@ int LibRaw::dcraw_process(void)
     if (callbacks.pre_scalecolors_cb)
       (callbacks.pre_scalecolors_cb)(this);
 
-    if (!O.no_auto_scale)
+    if (scaled)
+      SET_PROC_FLAG(LIBRAW_PROGRESS_SCALE_COLORS);
+    else if (!O.no_auto_scale)
     {
       scale_colors();
       SET_PROC_FLAG(LIBRAW_PROGRESS_SCALE_COLORS);
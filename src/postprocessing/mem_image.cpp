@@ -206,15 +206,8 @@ void LibRaw::get_mem_image_format(int *width, int *height, int *colors,
   *bps = O.output_bps;
 }
 
-int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
-
+void LibRaw::mem_image_gamma()
 {
-  // the image memory pointed to by scan0 is assumed to be in the format
-  // returned by get_mem_image_format
-  if ((imgdata.progress_flags & LIBRAW_PROGRESS_THUMB_MASK) <
-      LIBRAW_PROGRESS_PRE_INTERPOLATE)
-    return LIBRAW_OUT_OF_ORDER_CALL;
-
   if (libraw_internal_data.output_data.histogram)
   {
     int perc, val, total, t_white = 0x2000, c;
@@ -233,7 +226,15 @@ int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
       }
     gamma_curve(O.gamm[0], O.gamm[1], 2, int((t_white << 3) / O.bright));
   }
+}
 
+/*
+ Copies output rows [row0, row0 + nrows) to scan0 (first of them goes to
+ scan0 itself). Gamma curve should be set by mem_image_gamma() before.
+*/
+void LibRaw::copy_mem_image_rows(void *scan0, int stride, int bgr, int row0,
+                                 int nrows)
+{
   int s_iheight = S.iheight;
   int s_iwidth = S.iwidth;
   int s_width = S.width;
@@ -245,19 +246,24 @@ int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
   if (S.flip & 4)
     SWAP(S.height, S.width);
   int row;
+  const int rowend = MIN(int(S.height), row0 + nrows);
   // Per-row starting source offset equals flip_index(row, 0) (flip_index is a
   // pure read-only mapping), so each row is independent and the loop can run in
   // parallel. cstep is the per-column source stride. Rows write disjoint output.
   const int cstep = flip_index(0, 1) - flip_index(0, 0);
+  // image[][4] or packed imgdata.rgb_image[][3]
+  const int ps = imgdata.rgb_image ? 3 : 4;
+  const ushort *src =
+      imgdata.rgb_image ? imgdata.rgb_image[0] : imgdata.image[0];
 
 #if defined(LIBRAW_USE_OPENMP)
 #pragma omp parallel for
 #endif
-  for (row = 0; row < S.height; row++)
+  for (row = row0; row < rowend; row++)
   {
     int c, col;
     int soff = flip_index(row, 0);
-    uchar *bufp = ((uchar *)scan0) + row * stride;
+    uchar *bufp = ((uchar *)scan0) + (row - row0) * stride;
     uchar *ppm = bufp;
     ushort *ppm2 = (ushort *)bufp;
     // keep trivial decisions in the outer loop for speed
@@ -266,12 +272,12 @@ int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
       if (O.output_bps == 8)
       {
         for (col = 0; col < S.width; col++, soff += cstep)
-          FORBGR *ppm++ = imgdata.color.curve[imgdata.image[soff][c]] >> 8;
+          FORBGR *ppm++ = imgdata.color.curve[src[size_t(soff) * ps + c]] >> 8;
       }
       else
       {
         for (col = 0; col < S.width; col++, soff += cstep)
-          FORBGR *ppm2++ = imgdata.color.curve[imgdata.image[soff][c]];
+          FORBGR *ppm2++ = imgdata.color.curve[src[size_t(soff) * ps + c]];
       }
     }
     else
@@ -279,12 +285,12 @@ int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
       if (O.output_bps == 8)
       {
         for (col = 0; col < S.width; col++, soff += cstep)
-          FORRGB *ppm++ = imgdata.color.curve[imgdata.image[soff][c]] >> 8;
+          FORRGB *ppm++ = imgdata.color.curve[src[size_t(soff) * ps + c]] >> 8;
       }
       else
       {
         for (col = 0; col < S.width; col++, soff += cstep)
-          FORRGB *ppm2++ = imgdata.color.curve[imgdata.image[soff][c]];
+          FORRGB *ppm2++ = imgdata.color.curve[src[size_t(soff) * ps + c]];
       }
     }
 
@@ -295,9 +301,69 @@ int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
   S.iwidth = s_iwidth;
   S.width = s_width;
   S.height = s_hwight;
+}
+
+int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
+
+{
+  // the image memory pointed to by scan0 is assumed to be in the format
+  // returned by get_mem_image_format
+  if ((imgdata.progress_flags & LIBRAW_PROGRESS_THUMB_MASK) <
+      LIBRAW_PROGRESS_PRE_INTERPOLATE)
+    return LIBRAW_OUT_OF_ORDER_CALL;
 
+  mem_image_gamma();
+  copy_mem_image_rows(scan0, stride, bgr, 0, INT_MAX);
   return 0;
 }
+
+/*
+ Streaming variant of dcraw_make_mem_image(): output is produced in blocks of
+ rows_per_call scanlines (in get_mem_image_format() layout) and passed to cb,
+ so only one block is allocated instead of the full output bitmap.
+*/
+int LibRaw::dcraw_stream_mem_image(mem_image_rows_callback cb, void *data,
+                                   int rows_per_call)
+{
+  if (!cb)
+    return EINVAL;
+  if ((imgdata.progress_flags & LIBRAW_PROGRESS_THUMB_MASK) <
+      LIBRAW_PROGRESS_PRE_INTERPOLATE)
+    return LIBRAW_OUT_OF_ORDER_CALL;
+
+  int width, height, colors, bps;
+  get_mem_image_format(&width, &height, &colors, &bps);
+
+  size_t stride_size = safe_alloc_size_3((size_t)width, (size_t)(bps / 8), (size_t)colors);
+  if (stride_size == 0 || stride_size > INT_MAX)
+    return LIBRAW_TOO_BIG;
+  int stride = (int)stride_size;
+
+  if (rows_per_call <= 0)
+    rows_per_call = LIBRAW_MEM_IMAGE_STREAM_ROWS;
+  rows_per_call = MAX(1, MIN(rows_per_call, height));
+
+  size_t bufsize;
+  if (safe_mul_size_t((size_t)rows_per_call, stride_size, &bufsize) != 0)
+    return LIBRAW_TOO_BIG;
+  uchar *buf = (uchar *)::malloc(bufsize);
+  if (!buf)
+    return LIBRAW_UNSUFFICIENT_MEMORY;
+
+  mem_image_gamma();
+  for (int row = 0; row < height; row += rows_per_call)
+  {
+    int n = MIN(rows_per_call, height - row);
+    copy_mem_image_rows(buf, stride, 0, row, n);
+    if ((*cb)(data, row, n, buf, stride))
+    {
+      ::free(buf);
+      return LIBRAW_CANCELLED_BY_CALLBACK;
+    }
+  }
+  ::free(buf);
+  return LIBRAW_SUCCESS;
+}
 #undef FORBGR
 #undef FORRGB
 
@@ -31,6 +31,36 @@ void LibRaw::hat_transform(float *temp, float *base, int st, int size, int sc)
               base[st * (2 * size - 2 - (i + sc))];
 }
 
+#define WAVELET_STRIP 32
+
+static inline void hat_strip_row(float *temp, const float *b0, const float *b1,
+                                 const float *b2, int ncols)
+{
+  for (int k = 0; k < ncols; k++)
+    temp[k] = 2 * b0[k] + b1[k] + b2[k];
+}
+
+/*
+ * Column pass of the wavelet transform: hat_transform() applied to ncols
+ * adjacent columns at once, so every input row is read contiguously
+ * instead of walking one column with a stride of st floats.
+ * temp receives size rows of ncols values.
+ */
+static void hat_transform_strip(float *temp, const float *base, int st,
+                                int size, int sc, int ncols)
+{
+  int i;
+  for (i = 0; i < sc; i++, temp += ncols)
+    hat_strip_row(temp, base + st * i, base + st * (sc - i),
+                  base + st * (i + sc), ncols);
+  for (; i + sc < size; i++, temp += ncols)
+    hat_strip_row(temp, base + st * i, base + st * (i - sc),
+                  base + st * (i + sc), ncols);
+  for (; i < size; i++, temp += ncols)
+    hat_strip_row(temp, base + st * i, base + st * (i - sc),
+                  base + st * (2 * size - 2 - (i + sc)), ncols);
+}
+
 #if !defined(LIBRAW_USE_OPENMP)
 void LibRaw::wavelet_denoise()
 {
@@ -49,7 +79,8 @@ void LibRaw::wavelet_denoise()
   black <<= scale;
   FORC4 cblack[c] <<= scale;
   size = iheight * iwidth;
-  fimg = (float *)malloc((size * 3 + iheight + iwidth + 128) * sizeof *fimg);
+  fimg = (float *)malloc(
+      (size * 3 + iheight * WAVELET_STRIP + iwidth + 128) * sizeof *fimg);
   temp = fimg + size * 3;
   if ((nc = colors) == 3 && filters)
     nc++;
@@ -66,11 +97,17 @@ void LibRaw::wavelet_denoise()
         for (col = 0; col < iwidth; col++)
           fimg[lpass + row * iwidth + col] = temp[col] * 0.25f;
       }
-      for (col = 0; col < iwidth; col++)
+      for (col = 0; col < iwidth; col += WAVELET_STRIP)
       {
-        hat_transform(temp, fimg + lpass + col, iwidth, iheight, 1 << lev);
+        int ncols = MIN(WAVELET_STRIP, iwidth - col);
+        hat_transform_strip(temp, fimg + lpass + col, iwidth, iheight,
+                            1 << lev, ncols);
         for (row = 0; row < iheight; row++)
-          fimg[lpass + row * iwidth + col] = temp[row] * 0.25f;
+        {
+          float *dst = fimg + lpass + row * iwidth + col;
+          for (i = 0; i < ncols; i++)
+            dst[i] = temp[row * ncols + i] * 0.25f;
+        }
       }
       thold = threshold * noise[lev];
       for (i = 0; i < size; i++)
@@ -153,17 +190,16 @@ void LibRaw::wavelet_denoise()
   size = (int)safe_size_omp;
 
   /* SECURITY FIX: Check for integer overflow in allocation */
-  size_t alloc_elements_omp = (size_t)size * 3 + (size_t)iheight + (size_t)iwidth;
+  size_t alloc_elements_omp = (size_t)size * 3;
   if (alloc_elements_omp > SIZE_MAX / sizeof(float))
     return;
   fimg = (float *)malloc(alloc_elements_omp * sizeof *fimg);
-  temp = fimg + size * 3;
   if ((nc = colors) == 3 && filters)
     nc++;
 #pragma omp parallel default(shared) private(                                  \
     i, col, row, thold, lev, lpass, hpass, temp, c) firstprivate(scale, size)
   {
-    temp = (float *)malloc((iheight + iwidth) * sizeof *fimg);
+    temp = (float *)malloc((iheight * WAVELET_STRIP + iwidth) * sizeof *fimg);
     FORC(nc)
     { /* denoise R,G1,B,G3 individually */
 #pragma omp for
@@ -180,11 +216,17 @@ void LibRaw::wavelet_denoise()
             fimg[lpass + row * iwidth + col] = temp[col] * 0.25;
         }
 #pragma omp for
-        for (col = 0; col < iwidth; col++)
+        for (col = 0; col < iwidth; col += WAVELET_STRIP)
         {
-          hat_transform(temp, fimg + lpass + col, iwidth, iheight, 1 << lev);
+          int ncols = MIN(WAVELET_STRIP, iwidth - col);
+          hat_transform_strip(temp, fimg + lpass + col, iwidth, iheight,
+                              1 << lev, ncols);
           for (row = 0; row < iheight; row++)
-            fimg[lpass + row * iwidth + col] = temp[row] * 0.25;
+          {
+            float *dst = fimg + lpass + row * iwidth + col;
+            for (i = 0; i < ncols; i++)
+              dst[i] = temp[row * ncols + i] * 0.25;
+          }
         }
         thold = threshold * noise[lev];
 #pragma omp for
@@ -255,30 +297,52 @@ void LibRaw::wavelet_denoise()
 #endif
 void LibRaw::median_filter()
 {
-  ushort(*pix)[4];
-  int pass, c, i, j, k, med[9];
+  int pass, c;
   static const uchar opt[] = /* Optimal 9-element median search */
       {1, 2, 4, 5, 7, 8, 0, 1, 3, 4, 6, 7, 1, 2, 4, 5, 7, 8, 0,
        3, 5, 8, 4, 7, 3, 6, 1, 4, 2, 5, 4, 7, 4, 2, 6, 4, 4, 2};
+  const int lanes = 8; /* adjacent pixels run through the network together */
 
   for (pass = 1; pass <= med_passes; pass++)
   {
     RUN_CALLBACK(LIBRAW_PROGRESS_MEDIAN_FILTER, pass - 1, med_passes);
     for (c = 0; c < 3; c += 2)
     {
-      for (pix = image; pix < image + width * height; pix++)
-        pix[0][3] = pix[0][c];
-      for (pix = image + width; pix < image + width * (height - 1); pix++)
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) default(shared)
+#endif
+      for (int i = 0; i < width * height; i++)
+        image[i][3] = image[i][c];
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) default(shared)
+#endif
+      for (int row = 1; row < height - 1; row++)
       {
-        if ((pix - image + 1) % width < 2)
-          continue;
-        for (k = 0, i = -width; i <= width; i += width)
-          for (j = i - 1; j <= i + 1; j++)
-            med[k++] = pix[j][3] - pix[j][1];
-        for (i = 0; i < int(sizeof opt); i += 2)
-          if (med[opt[i]] > med[opt[i + 1]])
-            SWAP(med[opt[i]], med[opt[i + 1]]);
-        pix[0][c] = CLIP(med[4] + pix[0][1]);
+        int med[9][lanes];
+        memset(med, 0, sizeof med);
+        for (int col = 1; col < width - 1; col += lanes)
+        {
+          int n = MIN(lanes, width - 1 - col);
+          for (int k = 0; k < 9; k++)
+          {
+            ushort(*pix)[4] = image + (row + k / 3 - 1) * width + col + k % 3 - 1;
+            for (int x = 0; x < n; x++)
+              med[k][x] = pix[x][3] - pix[x][1];
+          }
+          for (int i = 0; i < int(sizeof opt); i += 2)
+          {
+            int *lo = med[opt[i]], *hi = med[opt[i + 1]];
+            for (int x = 0; x < lanes; x++)
+            {
+              int t = MIN(lo[x], hi[x]);
+              hi[x] = MAX(lo[x], hi[x]);
+              lo[x] = t;
+            }
+          }
+          ushort(*pix)[4] = image + row * width + col;
+          for (int x = 0; x < n; x++)
+            pix[x][c] = CLIP(med[4][x] + pix[x][1]);
+        }
       }
     }
   }
@@ -286,22 +350,26 @@ void LibRaw::median_filter()
 
 void LibRaw::blend_highlights()
 {
-  int clip = INT_MAX, row, col, c, i, j;
+  int clip = INT_MAX, c, i;
   static const float trans[2][4][4] = {
       {{1, 1, 1}, {1.7320508f, -1.7320508f, 0}, {-1, -1, 2}},
       {{1, 1, 1, 1}, {1, -1, 1, -1}, {1, 1, -1, -1}, {1, -1, -1, 1}}};
   static const float itrans[2][4][4] = {
       {{1, 0.8660254f, -0.5}, {1, -0.8660254f, -0.5}, {1, 0, 1}},
       {{1, 1, 1, 1}, {1, -1, 1, -1}, {1, 1, -1, -1}, {1, -1, -1, 1}}};
-  float cam[2][4], lab[2][4], sum[2], chratio;
 
   if ((unsigned)(colors - 3) > 1)
     return;
   RUN_CALLBACK(LIBRAW_PROGRESS_HIGHLIGHTS, 0, 2);
   FORCC if (clip > (i = int(65535.f * pre_mul[c]))) clip = i;
-  for (row = 0; row < height; row++)
-    for (col = 0; col < width; col++)
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) default(shared)
+#endif
+  for (int row = 0; row < height; row++)
+    for (int col = 0; col < width; col++)
     {
+      float cam[2][4], lab[2][4], sum[2], chratio;
+      int c, i, j;
       FORCC if (image[row * width + col][c] > clip) break;
       if (c == colors)
         continue;
@@ -330,13 +398,18 @@ void LibRaw::blend_highlights()
   RUN_CALLBACK(LIBRAW_PROGRESS_HIGHLIGHTS, 1, 2);
 }
 
+/*
+ * The map is built and applied one SCALE x SCALE cell per entry, so map
+ * rows are independent. Each spreading pass only reads entries that were
+ * positive before the pass (new ones are stored negated until the pass
+ * ends), so its rows are independent as well.
+ */
 #define SCALE (4 >> shrink)
 void LibRaw::recover_highlights()
 {
-  float *map, sum, wgt, grow;
-  int hsat[4], count, spread, change, val, i;
-  unsigned high, wide, mrow, mcol, row, col, kc, c, d, y, x;
-  ushort *pixel;
+  float *map, grow;
+  int hsat[4], spread, change, i;
+  unsigned high, wide, kc, c;
   static const signed char dir[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, 1},
                                         {1, 1},   {1, 0},  {1, -1}, {0, -1}};
 
@@ -362,15 +435,18 @@ void LibRaw::recover_highlights()
   {
     RUN_CALLBACK(LIBRAW_PROGRESS_HIGHLIGHTS, c - 1, colors - 1);
     memset(map, 0, high * wide * sizeof *map);
-    for (mrow = 0; mrow < high; mrow++)
-      for (mcol = 0; mcol < wide; mcol++)
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) default(shared)
+#endif
+    for (int mrow = 0; mrow < int(high); mrow++)
+      for (unsigned mcol = 0; mcol < wide; mcol++)
       {
-        count = 0;
-		sum = wgt = 0;
-        for (row = mrow * SCALE; row < (mrow + 1) * SCALE; row++)
-          for (col = mcol * SCALE; col < (mcol + 1) * SCALE; col++)
+        int count = 0;
+        float sum = 0, wgt = 0;
+        for (int row = mrow * SCALE; row < (mrow + 1) * SCALE; row++)
+          for (unsigned col = mcol * SCALE; col < (mcol + 1) * SCALE; col++)
           {
-            pixel = image[row * width + col];
+            ushort *pixel = image[row * width + col];
             if (pixel[c] / hsat[c] == 1 && pixel[kc] > 24000)
             {
               sum += pixel[c];
@@ -384,17 +460,20 @@ void LibRaw::recover_highlights()
       }
     for (spread = int(32.f / grow); spread--;)
     {
-      for (mrow = 0; mrow < high; mrow++)
-        for (mcol = 0; mcol < wide; mcol++)
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) default(shared)
+#endif
+      for (int mrow = 0; mrow < int(high); mrow++)
+        for (unsigned mcol = 0; mcol < wide; mcol++)
         {
           if (map[mrow * wide + mcol])
             continue;
-		  sum = 0;
-		  count = 0;
-          for (d = 0; d < 8; d++)
+          float sum = 0;
+          int count = 0;
+          for (unsigned d = 0; d < 8; d++)
           {
-            y = mrow + dir[d][0];
-            x = mcol + dir[d][1];
+            unsigned y = mrow + dir[d][0];
+            unsigned x = mcol + dir[d][1];
             if (y < high && x < wide && map[y * wide + x] > 0)
             {
               sum += (1 + (d & 1)) * map[y * wide + x];
@@ -404,7 +483,11 @@ void LibRaw::recover_highlights()
           if (count > 3)
             map[mrow * wide + mcol] = -(sum + grow) / (count + grow);
         }
-      for (change = i = 0; i < int(high * wide); i++)
+      change = 0;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) default(shared) reduction(|:change)
+#endif
+      for (i = 0; i < int(high * wide); i++)
         if (map[i] < 0)
         {
           map[i] = -map[i];
@@ -416,16 +499,19 @@ void LibRaw::recover_highlights()
     for (i = 0; i < int(high * wide); i++)
       if (map[i] == 0)
         map[i] = 1;
-    for (mrow = 0; mrow < high; mrow++)
-      for (mcol = 0; mcol < wide; mcol++)
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) default(shared)
+#endif
+    for (int mrow = 0; mrow < int(high); mrow++)
+      for (unsigned mcol = 0; mcol < wide; mcol++)
       {
-        for (row = mrow * SCALE; row < (mrow + 1) * SCALE; row++)
-          for (col = mcol * SCALE; col < (mcol + 1) * SCALE; col++)
+        for (int row = mrow * SCALE; row < (mrow + 1) * SCALE; row++)
+          for (unsigned col = mcol * SCALE; col < (mcol + 1) * SCALE; col++)
           {
-            pixel = image[row * width + col];
+            ushort *pixel = image[row * width + col];
             if (pixel[c] / hsat[c] > 1)
             {
-              val = int(pixel[kc] * map[mrow * wide + mcol]);
+              int val = int(pixel[kc] * map[mrow * wide + mcol]);
               if (pixel[c] < val)
                 pixel[c] = CLIP(val);
             }
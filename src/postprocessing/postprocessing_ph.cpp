@@ -23,9 +23,16 @@ int LibRaw::dcraw_process(void)
 
 void LibRaw::fuji_rotate() {}
 void LibRaw::convert_to_rgb_loop(float /*out_cam*/ [3][4]) {}
+void LibRaw::convert_to_rgb_rows(float /*out_cam*/ [3][4], ushort * /*dst*/, int /*dst_step*/) {}
 libraw_processed_image_t *LibRaw::dcraw_make_mem_image(int *) {
   return NULL;
 }
 libraw_processed_image_t *LibRaw::dcraw_make_mem_thumb(int *){ return NULL;}
+int LibRaw::dcraw_stream_mem_image(mem_image_rows_callback, void *, int)
+{
+  return LIBRAW_NOT_IMPLEMENTED;
+}
 void LibRaw::lin_interpolate_loop(int * /*code*/, int /*size*/) {}
 void LibRaw::scale_colors_loop(float /*scale_mul*/[4]) {}
+void LibRaw::scale_colors_mul(float /*scale_mul*/[4]) {}
+void LibRaw::scale_colors_aber() {}
@@ -81,68 +81,60 @@ void LibRaw::exp_bef(float shift, float smooth)
 }
 
 void LibRaw::convert_to_rgb_loop(float out_cam[3][4])
+{
+  convert_to_rgb_rows(out_cam, imgdata.image[0], 4);
+}
+
+/*
+ Color conversion of image[][4] into dst, dst_step ushorts per pixel:
+ image itself (4) or packed imgdata.rgb_image[][3] (3). Also fills the
+ histogram.
+*/
+void LibRaw::convert_to_rgb_rows(float out_cam[3][4], ushort *dst, int dst_step)
 {
   typedef int(*histbuf_t)[LIBRAW_HISTOGRAM_SIZE];
   histbuf_t const ghist = libraw_internal_data.output_data.histogram;
   memset(ghist, 0, sizeof(int) * LIBRAW_HISTOGRAM_SIZE * 4);
+  const int raw_color = libraw_internal_data.internal_output_params.raw_color;
+  const int colors = imgdata.idata.colors;
 
-  // Each branch runs the same per-pixel work in parallel over rows. Histogram
-  // bins are a cross-thread reduction, so each thread accumulates into a private
-  // copy and merges once at the end (matches the OpenMP idiom used elsewhere in
-  // the library). Without OpenMP the block runs once and writes ghist directly.
-  if (libraw_internal_data.internal_output_params.raw_color)
-  {
-    const int colors = imgdata.idata.colors;
+  // Rows are converted in parallel. Histogram bins are a cross-thread
+  // reduction, so each thread accumulates into a private copy and merges once
+  // at the end. Without OpenMP the block runs once and writes ghist directly.
 #if defined(LIBRAW_USE_OPENMP)
 #pragma omp parallel
 #endif
-    {
+  {
 #if defined(LIBRAW_USE_OPENMP)
-      histbuf_t hist =
-          (histbuf_t)::calloc(4, sizeof(int) * LIBRAW_HISTOGRAM_SIZE);
+    histbuf_t hist =
+        (histbuf_t)::calloc(4, sizeof(int) * LIBRAW_HISTOGRAM_SIZE);
 #else
-      histbuf_t hist = ghist;
+    histbuf_t hist = ghist;
 #endif
 #if defined(LIBRAW_USE_OPENMP)
 #pragma omp for
 #endif
-      for (int row = 0; row < S.height; row++)
+    for (int row = 0; row < S.height; row++)
+    {
+      const ushort *img = imgdata.image[(size_t)row * S.width];
+      ushort *out = dst + (size_t)row * S.width * dst_step;
+      if (raw_color)
       {
-        ushort *img = imgdata.image[(size_t)row * S.width];
-        for (int col = 0; col < S.width; col++, img += 4)
+        for (int col = 0; col < S.width; col++, img += 4, out += dst_step)
+        {
           for (int c = 0; c < colors; c++)
             hist[c][img[c] >> 3]++;
+          if (out != img)
+          {
+            out[0] = img[0];
+            out[1] = img[1];
+            out[2] = img[2];
+          }
+        }
       }
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp critical(histmerge)
+      else if (colors == 3)
       {
-        for (int c = 0; c < 4; c++)
-          for (int b = 0; b < LIBRAW_HISTOGRAM_SIZE; b++)
-            ghist[c][b] += hist[c][b];
-      }
-      ::free(hist);
-#endif
-    }
-  }
-  else if (imgdata.idata.colors == 3)
-  {
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp parallel
-#endif
-    {
-#if defined(LIBRAW_USE_OPENMP)
-      histbuf_t hist =
-          (histbuf_t)::calloc(4, sizeof(int) * LIBRAW_HISTOGRAM_SIZE);
-#else
-      histbuf_t hist = ghist;
-#endif
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp for
-#endif
-      for (int row = 0; row < S.height; row++)
-      {
-        ushort *img = imgdata.image[(size_t)row * S.width];
-        for (int col = 0; col < S.width; col++, img += 4)
+        for (int col = 0; col < S.width; col++, img += 4, out += dst_step)
         {
           float out0 = out_cam[0][0] * img[0] + out_cam[0][1] * img[1] +
                        out_cam[0][2] * img[2];
@@ -150,44 +142,17 @@ void LibRaw::convert_to_rgb_loop(float out_cam[3][4])
                        out_cam[1][2] * img[2];
           float out2 = out_cam[2][0] * img[0] + out_cam[2][1] * img[1] +
                        out_cam[2][2] * img[2];
-          img[0] = CLIP((int)out0);
-          img[1] = CLIP((int)out1);
-          img[2] = CLIP((int)out2);
-          hist[0][img[0] >> 3]++;
-          hist[1][img[1] >> 3]++;
-          hist[2][img[2] >> 3]++;
+          out[0] = CLIP((int)out0);
+          out[1] = CLIP((int)out1);
+          out[2] = CLIP((int)out2);
+          hist[0][out[0] >> 3]++;
+          hist[1][out[1] >> 3]++;
+          hist[2][out[2] >> 3]++;
         }
       }
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp critical(histmerge)
+      else if (colors == 4)
       {
-        for (int c = 0; c < 4; c++)
-          for (int b = 0; b < LIBRAW_HISTOGRAM_SIZE; b++)
-            ghist[c][b] += hist[c][b];
-      }
-      ::free(hist);
-#endif
-    }
-  }
-  else if (imgdata.idata.colors == 4)
-  {
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp parallel
-#endif
-    {
-#if defined(LIBRAW_USE_OPENMP)
-      histbuf_t hist =
-          (histbuf_t)::calloc(4, sizeof(int) * LIBRAW_HISTOGRAM_SIZE);
-#else
-      histbuf_t hist = ghist;
-#endif
-#if defined(LIBRAW_USE_OPENMP)
-#pragma omp for
-#endif
-      for (int row = 0; row < S.height; row++)
-      {
-        ushort *img = imgdata.image[(size_t)row * S.width];
-        for (int col = 0; col < S.width; col++, img += 4)
+        for (int col = 0; col < S.width; col++, img += 4, out += dst_step)
         {
           float out0 = out_cam[0][0] * img[0] + out_cam[0][1] * img[1] +
                        out_cam[0][2] * img[2] + out_cam[0][3] * img[3];
@@ -195,25 +160,25 @@ void LibRaw::convert_to_rgb_loop(float out_cam[3][4])
                        out_cam[1][2] * img[2] + out_cam[1][3] * img[3];
           float out2 = out_cam[2][0] * img[0] + out_cam[2][1] * img[1] +
                        out_cam[2][2] * img[2] + out_cam[2][3] * img[3];
-          img[0] = CLIP((int)out0);
-          img[1] = CLIP((int)out1);
-          img[2] = CLIP((int)out2);
-          hist[0][img[0] >> 3]++;
-          hist[1][img[1] >> 3]++;
-          hist[2][img[2] >> 3]++;
+          out[0] = CLIP((int)out0);
+          out[1] = CLIP((int)out1);
+          out[2] = CLIP((int)out2);
+          hist[0][out[0] >> 3]++;
+          hist[1][out[1] >> 3]++;
+          hist[2][out[2] >> 3]++;
           hist[3][img[3] >> 3]++;
         }
       }
+    }
 #if defined(LIBRAW_USE_OPENMP)
 #pragma omp critical(histmerge)
-      {
-        for (int c = 0; c < 4; c++)
-          for (int b = 0; b < LIBRAW_HISTOGRAM_SIZE; b++)
-            ghist[c][b] += hist[c][b];
-      }
-      ::free(hist);
-#endif
+    {
+      for (int c = 0; c < 4; c++)
+        for (int b = 0; b < LIBRAW_HISTOGRAM_SIZE; b++)
+          ghist[c][b] += hist[c][b];
     }
+    ::free(hist);
+#endif
   }
 }
 
@@ -100,7 +100,21 @@ void LibRaw::convert_to_rgb()
         for (out_cam[i][j] = 0.f, k = 0; k < 3; k++)
           out_cam[i][j] += float(out_rgb[output_color - 1][i][k] * rgb_cam[k][j]);
   }
-  convert_to_rgb_loop(out_cam);
+  if (imgdata.params.packed_rgb &&
+      (colors == 3 || (colors == 4 && output_color)))
+  {
+    // RGB result goes to rgb_image[][3], image[][4] is released. Both are
+    // allocated during this loop: peak memory is 7 ushorts per pixel here,
+    // 3 per pixel for the stages after it
+    imgdata.rgb_image =
+        (ushort(*)[3])realloc(imgdata.rgb_image, size_t(height) * width *
+                                                     sizeof *imgdata.rgb_image);
+    convert_to_rgb_rows(out_cam, imgdata.rgb_image[0], 3);
+    free(image);
+    image = 0;
+  }
+  else
+    convert_to_rgb_loop(out_cam);
 
   if (colors == 4 && output_color)
     colors = 3;
@@ -110,21 +124,34 @@ void LibRaw::convert_to_rgb()
 
 void LibRaw::scale_colors()
 {
-  unsigned bottom, right, size, row, col, ur, uc, i, x, y, c, sum[8];
-  int val;
-  double dsum[8], dmin, dmax;
-  float scale_mul[4], fr, fc;
-  ushort *img = 0, *pix;
+  float scale_mul[4];
 
   RUN_CALLBACK(LIBRAW_PROGRESS_SCALE_COLORS, 0, 2);
+  scale_colors_mul(scale_mul);
+  scale_colors_loop(scale_mul);
+  scale_colors_aber();
+  RUN_CALLBACK(LIBRAW_PROGRESS_SCALE_COLORS, 1, 2);
+}
+
+// Non-zero if white balance has to be measured from image[] data
+int LibRaw::scale_colors_auto_wb()
+{
+  return use_auto_wb ||
+         (use_camera_wb &&
+          (cam_mul[0] < -0.5 // LibRaw 0.19 and older: fallback to auto only if cam_mul[0] is set to -1
+           || (cam_mul[0] <= 0.00001f // New default: fallback to auto if no cam_mul parsed from metadata
+               && !(imgdata.rawparams.options & LIBRAW_RAWOPTIONS_CAMERAWB_FALLBACK_TO_DAYLIGHT))));
+}
+
+void LibRaw::scale_colors_mul(float scale_mul[4])
+{
+  unsigned bottom, right, row, col, x, y, c, sum[8];
+  int val;
+  double dsum[8], dmin, dmax;
 
   if (user_mul[0])
     memcpy(pre_mul, user_mul, sizeof pre_mul);
-  if (use_auto_wb || (use_camera_wb && 
-      (cam_mul[0] < -0.5  // LibRaw 0.19 and older: fallback to auto only if cam_mul[0] is set to -1
-          || (cam_mul[0] <= 0.00001f  // New default: fallback to auto if no cam_mul parsed from metadata
-              && !(imgdata.rawparams.options & LIBRAW_RAWOPTIONS_CAMERAWB_FALLBACK_TO_DAYLIGHT))
-          )))
+  if (scale_colors_auto_wb())
   {
     memset(dsum, 0, sizeof dsum);
     bottom = MIN(greybox[1] + greybox[3], height);
@@ -217,8 +244,15 @@ void LibRaw::scale_colors()
         cblack[6 + c / 2 % cblack[4] * cblack[5] + c % 2 % cblack[5]];
     cblack[4] = cblack[5] = 0;
   }
+}
+
+void LibRaw::scale_colors_aber()
+{
+  unsigned size, row, col, ur, uc, i, c;
+  float fr, fc;
+  ushort *img = 0, *pix;
+
   size = iheight * iwidth;
-  scale_colors_loop(scale_mul);
   if ((aber[0] != 1 || aber[2] != 1) && colors == 3)
   {
     for (c = 0; c < 4; c += 2)
@@ -253,20 +287,13 @@ void LibRaw::scale_colors()
       free(img);
     }
   }
-  RUN_CALLBACK(LIBRAW_PROGRESS_SCALE_COLORS, 1, 2);
 }
 
 // green equilibration
 void LibRaw::green_matching()
 {
-  int i, j;
-  double m1, m2, c1, c2;
-  int o1_1, o1_2, o1_3, o1_4;
-  int o2_1, o2_2, o2_3, o2_4;
-  ushort(*img)[4];
   const int margin = 3;
   int oj = 2, oi = 2;
-  float f;
   const float thr = 0.01f;
   if (half_size || shrink)
     return;
@@ -277,36 +304,99 @@ void LibRaw::green_matching()
   if (FC(oj, oi) != 3)
     oj--;
 
-  img = (ushort(*)[4])calloc(height * width, sizeof *image);
-  memcpy(img, image, height * width * sizeof *image);
+  /*
+   * Only channel 3 of rows oj, oj+2, ... is updated, and each of those
+   * pixels reads the original channel 3 of its row and of the rows two
+   * above and below. Bands of such rows run in parallel: each band keeps
+   * a three-row window of original values, and the first and last row of
+   * every band are saved beforehand since the neighbouring bands read them.
+   */
+  const int band_rows = 32;
+  const int rows = height - margin > oj ? (height - margin - oj + 1) / 2 : 0;
+  const int bands = (rows + band_rows - 1) / band_rows;
+  if (bands < 1)
+    return;
+
+#ifdef LIBRAW_USE_OPENMP
+  int buffer_count = omp_get_max_threads();
+#else
+  int buffer_count = 1;
+#endif
+  char **buffers = malloc_omp_buffers(buffer_count, width * 3 * sizeof(ushort));
+  ushort *edges = (ushort *)calloc(size_t(bands) * 2 * width, sizeof(ushort));
 
-  for (j = oj; j < height - margin; j += 2)
-    for (i = oi; i < width - margin; i += 2)
+  for (int band = 0; band < bands; band++)
+  {
+    int first = oj + band * band_rows * 2;
+    int last = oj + (MIN((band + 1) * band_rows, rows) - 1) * 2;
+    for (int i = 0; i < width; i++)
     {
-      o1_1 = img[(j - 1) * width + i - 1][1];
-      o1_2 = img[(j - 1) * width + i + 1][1];
-      o1_3 = img[(j + 1) * width + i - 1][1];
-      o1_4 = img[(j + 1) * width + i + 1][1];
-      o2_1 = img[(j - 2) * width + i][3];
-      o2_2 = img[(j + 2) * width + i][3];
-      o2_3 = img[j * width + i - 2][3];
-      o2_4 = img[j * width + i + 2][3];
-
-      m1 = (o1_1 + o1_2 + o1_3 + o1_4) / 4.0;
-      m2 = (o2_1 + o2_2 + o2_3 + o2_4) / 4.0;
+      edges[(band * 2) * width + i] = image[first * width + i][3];
+      edges[(band * 2 + 1) * width + i] = image[last * width + i][3];
+    }
+  }
 
-      c1 = (abs(o1_1 - o1_2) + abs(o1_1 - o1_3) + abs(o1_1 - o1_4) +
-            abs(o1_2 - o1_3) + abs(o1_3 - o1_4) + abs(o1_2 - o1_4)) /
-           6.0;
-      c2 = (abs(o2_1 - o2_2) + abs(o2_1 - o2_3) + abs(o2_1 - o2_4) +
-            abs(o2_2 - o2_3) + abs(o2_3 - o2_4) + abs(o2_2 - o2_4)) /
-           6.0;
-      if ((img[j * width + i][3] < maximum * 0.95) && (c1 < maximum * thr) &&
-          (c2 < maximum * thr))
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic) default(shared)
+#endif
+  for (int band = 0; band < bands; band++)
+  {
+#if defined(LIBRAW_USE_OPENMP)
+    ushort *win[3] = {(ushort *)buffers[omp_get_thread_num()]};
+#else
+    ushort *win[3] = {(ushort *)buffers[0]};
+#endif
+    win[1] = win[0] + width;
+    win[2] = win[1] + width;
+    int first = oj + band * band_rows * 2;
+    int last = oj + (MIN((band + 1) * band_rows, rows) - 1) * 2;
+    for (int i = 0; i < width; i++)
+    {
+      win[0][i] = band ? edges[(band * 2 - 1) * width + i]
+                       : image[(first - 2) * width + i][3];
+      win[1][i] = image[first * width + i][3];
+    }
+    for (int j = first; j <= last; j += 2)
+    {
+      /* win[0], win[1], win[2]: original rows j-2, j, j+2 */
+      const ushort *next = j == last && band + 1 < bands
+                               ? edges + (band * 2 + 2) * width
+                               : 0;
+      for (int i = 0; i < width; i++)
+        win[2][i] = next ? next[i] : image[(j + 2) * width + i][3];
+      for (int i = oi; i < width - margin; i += 2)
       {
-        f = float(image[j * width + i][3] * m1 / m2);
-        image[j * width + i][3] = f > 65535.f ? 0xffff : ushort(f);
+        int o1_1 = image[(j - 1) * width + i - 1][1];
+        int o1_2 = image[(j - 1) * width + i + 1][1];
+        int o1_3 = image[(j + 1) * width + i - 1][1];
+        int o1_4 = image[(j + 1) * width + i + 1][1];
+        int o2_1 = win[0][i];
+        int o2_2 = win[2][i];
+        int o2_3 = win[1][i - 2];
+        int o2_4 = win[1][i + 2];
+
+        double m1 = (o1_1 + o1_2 + o1_3 + o1_4) / 4.0;
+        double m2 = (o2_1 + o2_2 + o2_3 + o2_4) / 4.0;
+
+        double c1 = (abs(o1_1 - o1_2) + abs(o1_1 - o1_3) + abs(o1_1 - o1_4) +
+                     abs(o1_2 - o1_3) + abs(o1_3 - o1_4) + abs(o1_2 - o1_4)) /
+                    6.0;
+        double c2 = (abs(o2_1 - o2_2) + abs(o2_1 - o2_3) + abs(o2_1 - o2_4) +
+                     abs(o2_2 - o2_3) + abs(o2_3 - o2_4) + abs(o2_2 - o2_4)) /
+                    6.0;
+        if ((win[1][i] < maximum * 0.95) && (c1 < maximum * thr) &&
+            (c2 < maximum * thr))
+        {
+          float f = float(image[j * width + i][3] * m1 / m2);
+          image[j * width + i][3] = f > 65535.f ? 0xffff : ushort(f);
+        }
       }
+      ushort *t = win[0];
+      win[0] = win[1];
+      win[1] = win[2];
+      win[2] = t;
     }
-  free(img);
+  }
+  free(edges);
+  free_omp_buffers(buffers, buffer_count);
 }
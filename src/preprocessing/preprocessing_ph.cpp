@@ -20,5 +20,8 @@
 void LibRaw::copy_fuji_uncropped(unsigned short /*cblack*/[4],
 				 unsigned short * /*dmaxp*/) {}
 void LibRaw::copy_bayer(unsigned short /*cblack*/[4], unsigned short * /*dmaxp*/){}
+void LibRaw::copy_bayer_scaled(unsigned short /*cblack*/[4],
+			       float /*scale_mul*/[4], unsigned short * /*dmaxp*/){}
+void LibRaw::bayer_black_maximum(unsigned short /*cblack*/[4], unsigned short * /*dmaxp*/){}
 void LibRaw::raw2image_start(){}
 
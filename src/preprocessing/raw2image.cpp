@@ -17,6 +17,13 @@
 
 void LibRaw::raw2image_start()
 {
+  // packed output of previous dcraw_process() is not valid anymore
+  if (imgdata.rgb_image)
+  {
+    free(imgdata.rgb_image);
+    imgdata.rgb_image = 0;
+  }
+
   // restore color,sizes and internal data into raw_image fields
   memmove(&imgdata.color, &imgdata.rawdata.color, sizeof(imgdata.color));
   memmove(&imgdata.sizes, &imgdata.rawdata.sizes, sizeof(imgdata.sizes));
@@ -63,6 +70,7 @@ int LibRaw::raw2image(void)
 
   if (!imgdata.rawdata.raw_image && !imgdata.rawdata.color3_image && !imgdata.rawdata.color4_image)
 	  return LIBRAW_OUT_OF_ORDER_CALL;
+  perf_stage_begin();
 
   try
   {
@@ -204,6 +212,8 @@ int LibRaw::raw2image(void)
         LIBRAW_PROGRESS_START | LIBRAW_PROGRESS_OPEN |
         LIBRAW_PROGRESS_RAW2_IMAGE | LIBRAW_PROGRESS_IDENTIFY |
         LIBRAW_PROGRESS_SIZE_ADJUST | LIBRAW_PROGRESS_LOAD_RAW;
+    if (perf_enabled)
+      perf_stage_end(LIBRAW_PROGRESS_RAW2_IMAGE);
     return 0;
   }
   catch (const std::bad_alloc&)
@@ -307,12 +317,139 @@ void LibRaw::copy_bayer(unsigned short cblack[4], unsigned short *dmaxp)
   }
 }
 
+// Color of raw pixel (row, col) repeats every 48 columns for all supported
+// layouts (2 for Bayer, 16 for Leaf 'filters == 1', 6 for X-Trans)
+#define LIBRAW_FCOL_PERIOD 48
+
+void LibRaw::bayer_black_maximum(unsigned short cblack[4],
+                                 unsigned short *dmaxp)
+{
+  int maxHeight = MIN(int(S.height), int(S.raw_height) - int(S.top_margin));
+  int maxWidth = MIN(int(S.width), int(S.raw_width) - int(S.left_margin));
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp parallel for schedule(dynamic) default(none) shared(dmaxp) firstprivate(cblack, maxHeight, maxWidth)
+#endif
+  for (int row = 0; row < maxHeight; row++)
+  {
+    unsigned short blk[LIBRAW_FCOL_PERIOD];
+    for (int p = 0; p < LIBRAW_FCOL_PERIOD; p++)
+      blk[p] = cblack[fcol(row, p)];
+    const unsigned short *src =
+        imgdata.rawdata.raw_image + (row + S.top_margin) * S.raw_pitch / 2 +
+        S.left_margin;
+    unsigned short ldmax = 0;
+    for (int col0 = 0; col0 < maxWidth; col0 += LIBRAW_FCOL_PERIOD)
+    {
+      const int n = MIN(LIBRAW_FCOL_PERIOD, maxWidth - col0);
+      for (int p = 0; p < n; p++)
+      {
+        unsigned short val = src[col0 + p];
+        val = val > blk[p] ? val - blk[p] : 0;
+        ldmax = val > ldmax ? val : ldmax;
+      }
+    }
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp critical(dataupdate)
+#endif
+    {
+      if (*dmaxp < ldmax)
+        *dmaxp = ldmax;
+    }
+  }
+}
+
+/*
+ Fused copy_bayer() + scale_colors_loop(): one pass over raw_image that
+ subtracts black, tracks the data maximum and applies white balance scale,
+ writing each image[] row (all 4 channels, so no prior zeroing is needed)
+ while it is still in cache. Result is identical to the separate passes.
+*/
+void LibRaw::copy_bayer_scaled(unsigned short cblack[4], float scale_mul[4],
+                               unsigned short *dmaxp)
+{
+  int maxHeight = MIN(int(S.height), int(S.raw_height) - int(S.top_margin));
+  int maxWidth = MIN(int(S.width), int(S.raw_width) - int(S.left_margin));
+  const int shrink = IO.shrink;
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp parallel for schedule(dynamic) default(none) shared(dmaxp) firstprivate(cblack, scale_mul, maxHeight, maxWidth, shrink)
+#endif
+  for (int irow = 0; irow < int(S.iheight); irow++)
+  {
+    ushort(*dst)[4] = imgdata.image + irow * S.iwidth;
+    memset(dst, 0, S.iwidth * sizeof(*dst));
+    unsigned short ldmax = 0;
+    for (int row = irow << shrink; row < ((irow + 1) << shrink) && row < maxHeight;
+         row++)
+    {
+      unsigned short blk[LIBRAW_FCOL_PERIOD];
+      unsigned char clr[LIBRAW_FCOL_PERIOD];
+      int bsub[LIBRAW_FCOL_PERIOD];
+      float mul[LIBRAW_FCOL_PERIOD];
+      // per-channel black left after inline subtraction (cblack[4..5]
+      // pattern is indexed by image position, as in scale_colors_loop)
+      const unsigned *pattern =
+          C.cblack[4] && C.cblack[5]
+              ? C.cblack + 6 + irow % C.cblack[4] * C.cblack[5]
+              : 0;
+      for (int p = 0; p < LIBRAW_FCOL_PERIOD; p++)
+      {
+        int cc = fcol(row, p);
+        clr[p] = (unsigned char)cc;
+        blk[p] = cblack[cc];
+        bsub[p] = int(C.cblack[cc]);
+        mul[p] = scale_mul[cc];
+      }
+      const unsigned short *src =
+          imgdata.rawdata.raw_image + (row + S.top_margin) * S.raw_pitch / 2 +
+          S.left_margin;
+      for (int col0 = 0; col0 < maxWidth; col0 += LIBRAW_FCOL_PERIOD)
+      {
+        const int n = MIN(LIBRAW_FCOL_PERIOD, maxWidth - col0);
+        for (int p = 0; p < n; p++)
+        {
+          const int col = col0 + p;
+          unsigned short raw = src[col];
+          raw = raw > blk[p] ? raw - blk[p] : 0;
+          ldmax = raw > ldmax ? raw : ldmax;
+          int val = raw;
+          if (val)
+            val -= bsub[p] +
+                   (pattern ? int(pattern[(col >> shrink) % C.cblack[5]]) : 0);
+          val = int(val * mul[p]);
+          dst[col >> shrink][clr[p]] = CLIP(val);
+        }
+      }
+    }
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp critical(dataupdate)
+#endif
+    {
+      if (*dmaxp < ldmax)
+        *dmaxp = ldmax;
+    }
+  }
+}
+
 int LibRaw::raw2image_ex(int do_subtract_black)
 {
+  return raw2image_ex_internal(do_subtract_black, 0);
+}
+
+/*
+ If do_scale_colors is non-NULL and *do_scale_colors is set, black
+ subtraction, adjust_maximum() and scale_colors() are done together with the
+ copy when the data layout allows it; *do_scale_colors is cleared otherwise.
+*/
+int LibRaw::raw2image_ex_internal(int do_subtract_black, int *do_scale_colors)
+{
+  int fuse_scale = do_scale_colors && *do_scale_colors;
+  if (do_scale_colors)
+    *do_scale_colors = 0;
 
   CHECK_ORDER_LOW(LIBRAW_PROGRESS_LOAD_RAW);
   if (!imgdata.rawdata.raw_image && !imgdata.rawdata.color3_image && !imgdata.rawdata.color4_image)
     return LIBRAW_OUT_OF_ORDER_CALL;
+  perf_stage_begin();
 
   try
   {
@@ -408,7 +545,21 @@ int LibRaw::raw2image_ex(int do_subtract_black)
     }
     INT64 alloc_sz = INT64(alloc_width) * INT64(alloc_height);
 
-    if (imgdata.image)
+    if (fuse_scale &&
+        (!do_subtract_black || IO.fuji_width || !imgdata.rawdata.raw_image ||
+         !(imgdata.idata.filters || P1.colors == 1) ||
+         load_raw == &LibRaw::canon_600_load_raw))
+      fuse_scale = 0;
+
+    if (fuse_scale) // every image[] row is written by copy_bayer_scaled()
+    {
+      imgdata.image = (ushort(*)[4])realloc(imgdata.image,
+                                            alloc_sz * sizeof(*imgdata.image));
+      INT64 used = INT64(S.iheight) * INT64(S.iwidth);
+      memset(imgdata.image + used, 0,
+             (alloc_sz - used) * sizeof(*imgdata.image));
+    }
+    else if (imgdata.image)
     {
       imgdata.image = (ushort(*)[4])realloc(imgdata.image,
                                             alloc_sz * sizeof(*imgdata.image));
@@ -493,6 +644,28 @@ int LibRaw::raw2image_ex(int do_subtract_black)
           copy_fuji_uncropped(cblack, &dmax);
         }
       } // end Fuji
+      else if (fuse_scale)
+      {
+        float scale_mul[4];
+        RUN_CALLBACK(LIBRAW_PROGRESS_SCALE_COLORS, 0, 2);
+        // adjust_maximum() needs data maximum before scale is known
+        if (O.adjust_maximum_thr >= 0.00001 && O.user_sat <= 0 &&
+            !(decoder_info.decoder_flags & LIBRAW_DECODER_FIXEDMAXC))
+          bayer_black_maximum(cblack, &dmax);
+        C.data_maximum = (int)dmax;
+        C.maximum -= C.black;
+        C.cblack[0] = C.cblack[1] = C.cblack[2] = C.cblack[3] = 0;
+        C.black = 0;
+        if (!(decoder_info.decoder_flags & LIBRAW_DECODER_FIXEDMAXC))
+          adjust_maximum();
+        if (O.user_sat > 0)
+          C.maximum = O.user_sat;
+        scale_colors_mul(scale_mul);
+        copy_bayer_scaled(cblack, scale_mul, &dmax);
+        scale_colors_aber();
+        RUN_CALLBACK(LIBRAW_PROGRESS_SCALE_COLORS, 1, 2);
+        *do_scale_colors = 1;
+      }
       else
       {
         copy_bayer(cblack, &dmax);
@@ -565,6 +738,8 @@ int LibRaw::raw2image_ex(int do_subtract_black)
         LIBRAW_PROGRESS_START | LIBRAW_PROGRESS_OPEN |
         LIBRAW_PROGRESS_RAW2_IMAGE | LIBRAW_PROGRESS_IDENTIFY |
         LIBRAW_PROGRESS_SIZE_ADJUST | LIBRAW_PROGRESS_LOAD_RAW;
+    if (perf_enabled)
+      perf_stage_end(LIBRAW_PROGRESS_RAW2_IMAGE);
     return 0;
   }
   catch (const LibRaw_exceptions& err)
@@ -17,6 +17,31 @@
  */
 
 #include "../../internal/dcraw_defs.h"
+#include <vector>
+
+/*
+   Positions of the adobe_coeff() table entries grouped by maker index, in
+   table order, so a lookup only scans the entries of one maker.
+ */
+struct adobe_maker_index_t
+{
+  unsigned start[LIBRAW_CAMERAMAKER_TheLastOne + 2];
+  std::vector<unsigned short> pos;
+
+  template <class T> adobe_maker_index_t(const T *table, unsigned count)
+  {
+    memset(start, 0, sizeof(start));
+    for (unsigned i = 0; i < count; i++)
+      if (table[i].m_idx < LIBRAW_CAMERAMAKER_TheLastOne)
+        start[table[i].m_idx + 2]++;
+    for (unsigned m = 2; m < LIBRAW_CAMERAMAKER_TheLastOne + 2; m++)
+      start[m] += start[m - 1];
+    pos.resize(count);
+    for (unsigned i = 0; i < count; i++)
+      if (table[i].m_idx < LIBRAW_CAMERAMAKER_TheLastOne)
+        pos[start[table[i].m_idx + 1]++] = (unsigned short)i;
+  }
+};
 
 /*
    All matrices are from Adobe DNG Converter unless otherwise noted.
@@ -25,7 +50,7 @@ int LibRaw::adobe_coeff(unsigned make_idx, const char *t_model,
                         int internal_only)
 {
   // clang-format off
-  static const struct
+  static const struct adobe_coeff_t
   {
 	  unsigned m_idx;
 	  const char *prefix;
@@ -1858,6 +1883,8 @@ int LibRaw::adobe_coeff(unsigned make_idx, const char *t_model,
   };
   // clang-format on
 
+  static const adobe_maker_index_t by_maker(table,
+                                            sizeof table / sizeof *table);
   double cam_xyz[4][3];
   //char name[130];
   int i, j;
@@ -1874,40 +1901,41 @@ int LibRaw::adobe_coeff(unsigned make_idx, const char *t_model,
   }
   int rblack = black + bl4 + bl64;
 
-  for (i = 0; i < int(sizeof table / sizeof *table); i++)
+  if (make_idx >= LIBRAW_CAMERAMAKER_TheLastOne)
+    return 0;
+  for (unsigned k = by_maker.start[make_idx];
+       k < by_maker.start[make_idx + 1]; k++)
   {
-	  if (table[i].m_idx == make_idx)
+	  i = by_maker.pos[k];
+	  size_t l = strlen(table[i].prefix);
+	  if (!l ||  !strncasecmp(t_model, table[i].prefix, l))
 	  {
-		  size_t l = strlen(table[i].prefix);
-		  if (!l ||  !strncasecmp(t_model, table[i].prefix, l))
+		  if (!dng_version)
 		  {
-			  if (!dng_version)
+			  if (table[i].t_black > 0)
 			  {
-				  if (table[i].t_black > 0)
-				  {
-					  black = (ushort)table[i].t_black;
-					  memset(cblack, 0, sizeof(cblack));
-				  }
-				  else if (table[i].t_black < 0 && rblack == 0)
-				  {
-					  black = (ushort)(-table[i].t_black);
-					  memset(cblack, 0, sizeof(cblack));
-				  }
-				  if (table[i].t_maximum)
-					  maximum = (ushort)table[i].t_maximum;
+				  black = (ushort)table[i].t_black;
+				  memset(cblack, 0, sizeof(cblack));
 			  }
-			  if (table[i].trans[0])
+			  else if (table[i].t_black < 0 && rblack == 0)
 			  {
-				  for (raw_color = j = 0; j < 12; j++)
-					  if (internal_only)
-						  imgdata.color.cam_xyz[j / 3][j % 3] = table[i].trans[j] / 10000.f;
-					  else
-                          ((double *)cam_xyz)[j] = imgdata.color.cam_xyz[j / 3][j % 3] = table[i].trans[j] / 10000.f;
-				  if (!internal_only)
-					  cam_xyz_coeff(rgb_cam, cam_xyz);
+				  black = (ushort)(-table[i].t_black);
+				  memset(cblack, 0, sizeof(cblack));
 			  }
-			  return 1; // CM found
+			  if (table[i].t_maximum)
+				  maximum = (ushort)table[i].t_maximum;
+		  }
+		  if (table[i].trans[0])
+		  {
+			  for (raw_color = j = 0; j < 12; j++)
+				  if (internal_only)
+					  imgdata.color.cam_xyz[j / 3][j % 3] = table[i].trans[j] / 10000.f;
+				  else
+					  ((double *)cam_xyz)[j] = imgdata.color.cam_xyz[j / 3][j % 3] = table[i].trans[j] / 10000.f;
+			  if (!internal_only)
+				  cam_xyz_coeff(rgb_cam, cam_xyz);
 		  }
+		  return 1; // CM found
 	  }
   }
   return 0; // CM not found
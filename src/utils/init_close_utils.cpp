@@ -37,6 +37,10 @@ LibRaw::LibRaw(unsigned int flags) : memmgr(1024)
   cleargps(&imgdata.other.parsed_gps);
   ZERO(libraw_internal_data);
   ZERO(callbacks);
+  perf_enabled = 0;
+  ZERO(perf_stats);
+  ZERO(perf_mark);
+  perf_stream = NULL;
 
   _rawspeed_camerameta = _rawspeed_decoder = NULL;
   _rawspeed3_handle = NULL;
@@ -85,6 +89,7 @@ LibRaw::LibRaw(unsigned int flags) : memmgr(1024)
   imgdata.rawparams.use_dngsdk = LIBRAW_DNG_DEFAULT;
   imgdata.params.no_auto_scale = 0;
   imgdata.params.no_interpolation = 0;
+  imgdata.params.packed_rgb = 0;
   imgdata.rawparams.specials = 0; /* was inverted : LIBRAW_PROCESSING_DP2Q_INTERPOLATERG |      LIBRAW_PROCESSING_DP2Q_INTERPOLATEAF; */
   imgdata.rawparams.options = LIBRAW_RAWOPTIONS_CONVERTFLOAT_TO_INT;
   imgdata.rawparams.sony_arw2_posterization_thr = 0;
@@ -92,6 +97,7 @@ LibRaw::LibRaw(unsigned int flags) : memmgr(1024)
   imgdata.params.green_matching = 0;
   imgdata.rawparams.custom_camera_strings = 0;
   imgdata.rawparams.coolscan_nef_gamma = 1.0f;
+  imgdata.rawparams.cr3_downscale = 0;
   imgdata.parent_class = this;
   imgdata.progress_flags = 0;
   imgdata.color.dng_levels.baseline_exposure = -999.f;
@@ -139,6 +145,7 @@ void LibRaw::recycle()
   } while (0)
 
   FREE(imgdata.image);
+  FREE(imgdata.rgb_image);
 
   // explicit cleanup of afdata allocations; entire array is zeroed below
   for (int i = 0; i < LIBRAW_AFDATA_MAXCOUNT; i++)
@@ -160,7 +160,20 @@ int LibRaw::open_file(const char *fname)
 #ifdef LIBRAW_WIN32_CALLS
         stream = new LibRaw_bigfile_buffered_datastream(fname);
 #else
-        stream = new LibRaw_bigfile_datastream(fname);
+        stream = 0;
+#ifdef LIBRAW_USE_MMAP_DATASTREAM
+        if (imgdata.rawparams.options & LIBRAW_RAWOPTIONS_USE_MMAP)
+        {
+            stream = new LibRaw_mmap_datastream(fname);
+            if (!stream->valid()) // not mappable (pipe, empty file, no VM space)
+            {
+                delete stream;
+                stream = 0;
+            }
+        }
+#endif
+        if (!stream)
+            stream = new LibRaw_bigfile_datastream(fname);
 #endif
     }
     catch (const std::bad_alloc&)
@@ -287,6 +300,7 @@ int LibRaw::open_bayer(const unsigned char *buffer, unsigned datalen,
     return LIBRAW_IO_ERROR;
   }
   ID.input = stream;
+  perf_stage_begin();
   SET_PROC_FLAG(LIBRAW_PROGRESS_OPEN);
   // From identify
   initdata();
@@ -487,6 +501,7 @@ int LibRaw::open_datastream(LibRaw_abstract_datastream *stream)
   try
   {
 	  ID.input = stream;
+	  perf_stage_begin();
 	  SET_PROC_FLAG(LIBRAW_PROGRESS_OPEN);
 
 	  identify();
@@ -836,6 +851,9 @@ int LibRaw::open_datastream(LibRaw_abstract_datastream *stream)
             parse_fuji_compressed_header(); // try to use compressed header: X-H2S may record wrong data size
 		  }
 	  }
+      if (load_raw == &LibRaw::crxLoadRaw)
+        crxSetupDownscale(); // shrink sizes for rawparams.cr3_downscale
+
       // set raw_inset_crops[1] via raw_aspect
       if (imgdata.sizes.raw_aspect >= LIBRAW_IMAGE_ASPECT_MINIMAL_REAL_ASPECT_VALUE
           && imgdata.sizes.raw_aspect <= LIBRAW_IMAGE_ASPECT_MAXIMAL_REAL_ASPECT_VALUE
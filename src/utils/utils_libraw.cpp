@@ -15,6 +15,8 @@
 
 #include "../../internal/libraw_cxx_defs.h"
 #include "../../internal/libraw_checked_buffer.h"
+#include <chrono>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -255,6 +257,442 @@ int LibRaw::sraw_midpoint()
     return 0;
 }
 
+#define LIBRAW_MEMMGR_SHARDS 16
+#define LIBRAW_MEMMGR_REUSE_MINSIZE (256 * 1024)
+#define LIBRAW_MEMMGR_REUSE_COUNT 16
+
+struct libraw_memmgr_block
+{
+  void *ptr;
+  size_t size;
+};
+
+/* Open addressing hash set of live blocks, one per shard */
+struct libraw_memmgr_shard
+{
+  libraw_memmgr_block *slots;
+  size_t cap, count;
+#ifdef LIBRAW_USE_OPENMP
+  omp_lock_t lock;
+#endif
+};
+
+struct libraw_memmgr_tracker
+{
+  libraw_memmgr_shard shard[LIBRAW_MEMMGR_SHARDS];
+  libraw_allocator_t allocator;
+  bool user_allocator;
+  bool reuse;
+  /* blocks kept for reuse: allocated, but not tracked as live */
+  libraw_memmgr_block cache[LIBRAW_MEMMGR_REUSE_COUNT];
+  int cached;
+  /* cumulative bytes requested via malloc/calloc/realloc */
+  INT64 requested;
+#ifdef LIBRAW_USE_OPENMP
+  omp_lock_t cache_lock;
+#endif
+};
+
+static inline void memmgr_count(libraw_memmgr_tracker *t, size_t size)
+{
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+  t->requested += INT64(size);
+}
+
+static inline UINT64 memmgr_hash(void *ptr)
+{
+  UINT64 h = UINT64(uintptr_t(ptr) >> 4) * 0x9E3779B97F4A7C15ULL;
+  return h ^ (h >> 29);
+}
+
+static bool memmgr_insert(libraw_memmgr_shard &s, void *ptr, size_t size, UINT64 h)
+{
+  if ((s.count + 1) * 2 > s.cap)
+  {
+    size_t ncap = s.cap ? s.cap * 2 : 64;
+    libraw_memmgr_block *nslots =
+        (libraw_memmgr_block *)::calloc(ncap, sizeof(libraw_memmgr_block));
+    if (!nslots)
+      return false;
+    for (size_t i = 0; i < s.cap; i++)
+      if (s.slots[i].ptr)
+      {
+        size_t j = size_t(memmgr_hash(s.slots[i].ptr)) & (ncap - 1);
+        while (nslots[j].ptr)
+          j = (j + 1) & (ncap - 1);
+        nslots[j] = s.slots[i];
+      }
+    ::free(s.slots);
+    s.slots = nslots;
+    s.cap = ncap;
+  }
+  size_t i = size_t(h) & (s.cap - 1);
+  while (s.slots[i].ptr)
+    i = (i + 1) & (s.cap - 1);
+  s.slots[i].ptr = ptr;
+  s.slots[i].size = size;
+  s.count++;
+  return true;
+}
+
+/* returns false if ptr is not tracked */
+static bool memmgr_remove(libraw_memmgr_shard &s, void *ptr, UINT64 h, size_t *size)
+{
+  if (!s.count)
+    return false;
+  const size_t mask = s.cap - 1;
+  size_t i = size_t(h) & mask;
+  while (s.slots[i].ptr != ptr)
+  {
+    if (!s.slots[i].ptr)
+      return false;
+    i = (i + 1) & mask;
+  }
+  if (size)
+    *size = s.slots[i].size;
+  /* backward shift deletion: keep probe sequences unbroken, no tombstones */
+  size_t j = i;
+  while (true)
+  {
+    j = (j + 1) & mask;
+    if (!s.slots[j].ptr)
+      break;
+    size_t home = size_t(memmgr_hash(s.slots[j].ptr)) & mask;
+    if (((j - home) & mask) >= ((j - i) & mask))
+    {
+      s.slots[i] = s.slots[j];
+      i = j;
+    }
+  }
+  s.slots[i].ptr = NULL;
+  s.count--;
+  return true;
+}
+
+static inline void memmgr_lock(libraw_memmgr_shard &s)
+{
+#ifdef LIBRAW_USE_OPENMP
+  omp_set_lock(&s.lock);
+#endif
+}
+static inline void memmgr_unlock(libraw_memmgr_shard &s)
+{
+#ifdef LIBRAW_USE_OPENMP
+  omp_unset_lock(&s.lock);
+#endif
+}
+
+static void memmgr_track(libraw_memmgr_tracker *t, void *ptr, size_t size)
+{
+  UINT64 h = memmgr_hash(ptr);
+  libraw_memmgr_shard &s = t->shard[h >> 60];
+  memmgr_lock(s);
+  bool ok = memmgr_insert(s, ptr, size, h);
+  memmgr_unlock(s);
+  if (!ok)
+  {
+    if (t->user_allocator)
+      t->allocator.free_func(t->allocator.data, ptr);
+    else
+      ::free(ptr);
+    throw LIBRAW_EXCEPTION_MEMPOOL;
+  }
+}
+
+static bool memmgr_untrack(libraw_memmgr_tracker *t, void *ptr, size_t *size)
+{
+  UINT64 h = memmgr_hash(ptr);
+  libraw_memmgr_shard &s = t->shard[h >> 60];
+  memmgr_lock(s);
+  bool ret = memmgr_remove(s, ptr, h, size);
+  memmgr_unlock(s);
+  return ret;
+}
+
+static void *memmgr_sys_malloc(libraw_memmgr_tracker *t, size_t size)
+{
+#ifdef LIBRAW_USE_CALLOC_INSTEAD_OF_MALLOC
+  if (t->user_allocator)
+    return t->allocator.calloc_func(t->allocator.data, size, 1);
+  return ::calloc(size, 1);
+#else
+  if (t->user_allocator)
+    return t->allocator.malloc_func(t->allocator.data, size);
+  return ::malloc(size);
+#endif
+}
+
+static void memmgr_sys_free(libraw_memmgr_tracker *t, void *ptr)
+{
+  if (t->user_allocator)
+    t->allocator.free_func(t->allocator.data, ptr);
+  else
+    ::free(ptr);
+}
+
+/* Smallest cached block of [size, 2*size] bytes, NULL if none */
+static void *memmgr_reuse_get(libraw_memmgr_tracker *t, size_t size, size_t *got)
+{
+  if (!t->reuse || size < LIBRAW_MEMMGR_REUSE_MINSIZE)
+    return NULL;
+  void *ret = NULL;
+#ifdef LIBRAW_USE_OPENMP
+  omp_set_lock(&t->cache_lock);
+#endif
+  int best = -1;
+  for (int i = 0; i < t->cached; i++)
+    if (t->cache[i].size >= size && t->cache[i].size / 2 <= size &&
+        (best < 0 || t->cache[i].size < t->cache[best].size))
+      best = i;
+  if (best >= 0)
+  {
+    ret = t->cache[best].ptr;
+    *got = t->cache[best].size;
+    t->cache[best] = t->cache[--t->cached];
+  }
+#ifdef LIBRAW_USE_OPENMP
+  omp_unset_lock(&t->cache_lock);
+#endif
+  return ret;
+}
+
+/* Keeps an untracked block for reuse or frees it */
+static void memmgr_release(libraw_memmgr_tracker *t, void *ptr, size_t size)
+{
+  if (t->reuse && size >= LIBRAW_MEMMGR_REUSE_MINSIZE)
+  {
+#ifdef LIBRAW_USE_OPENMP
+    omp_set_lock(&t->cache_lock);
+#endif
+    if (t->cached == LIBRAW_MEMMGR_REUSE_COUNT)
+    {
+      /* full: replace the smallest cached block if this one is larger */
+      int smallest = 0;
+      for (int i = 1; i < t->cached; i++)
+        if (t->cache[i].size < t->cache[smallest].size)
+          smallest = i;
+      if (t->cache[smallest].size < size)
+      {
+        libraw_memmgr_block evicted = t->cache[smallest];
+        t->cache[smallest].ptr = ptr;
+        t->cache[smallest].size = size;
+        ptr = evicted.ptr;
+      }
+    }
+    else
+    {
+      t->cache[t->cached].ptr = ptr;
+      t->cache[t->cached].size = size;
+      t->cached++;
+      ptr = NULL;
+    }
+#ifdef LIBRAW_USE_OPENMP
+    omp_unset_lock(&t->cache_lock);
+#endif
+  }
+  if (ptr)
+    memmgr_sys_free(t, ptr);
+}
+
+static void memmgr_flush_cache(libraw_memmgr_tracker *t)
+{
+#ifdef LIBRAW_USE_OPENMP
+  omp_set_lock(&t->cache_lock);
+#endif
+  for (int i = 0; i < t->cached; i++)
+    memmgr_sys_free(t, t->cache[i].ptr);
+  t->cached = 0;
+#ifdef LIBRAW_USE_OPENMP
+  omp_unset_lock(&t->cache_lock);
+#endif
+}
+
+libraw_memmgr::libraw_memmgr(unsigned ee) : extra_bytes(ee)
+{
+  libraw_memmgr_tracker *t =
+      (libraw_memmgr_tracker *)::calloc(1, sizeof(libraw_memmgr_tracker));
+#ifdef LIBRAW_USE_OPENMP
+  if (t)
+  {
+    for (int i = 0; i < LIBRAW_MEMMGR_SHARDS; i++)
+      omp_init_lock(&t->shard[i].lock);
+    omp_init_lock(&t->cache_lock);
+  }
+#endif
+  tracker = t;
+}
+
+libraw_memmgr::~libraw_memmgr()
+{
+  libraw_memmgr_tracker *t = (libraw_memmgr_tracker *)tracker;
+  if (!t)
+    return;
+  t->reuse = false;
+  cleanup();
+  memmgr_flush_cache(t);
+  for (int i = 0; i < LIBRAW_MEMMGR_SHARDS; i++)
+  {
+    ::free(t->shard[i].slots);
+#ifdef LIBRAW_USE_OPENMP
+    omp_destroy_lock(&t->shard[i].lock);
+#endif
+  }
+#ifdef LIBRAW_USE_OPENMP
+  omp_destroy_lock(&t->cache_lock);
+#endif
+  ::free(t);
+}
+
+void libraw_memmgr::set_allocator(const libraw_allocator_t *allocator)
+{
+  libraw_memmgr_tracker *t = (libraw_memmgr_tracker *)tracker;
+  if (!t)
+    return;
+  memmgr_flush_cache(t);
+  if (allocator && allocator->malloc_func && allocator->calloc_func &&
+      allocator->realloc_func && allocator->free_func)
+  {
+    t->allocator = *allocator;
+    t->user_allocator = true;
+  }
+  else
+    t->user_allocator = false;
+}
+
+void libraw_memmgr::set_reuse(int enable)
+{
+  libraw_memmgr_tracker *t = (libraw_memmgr_tracker *)tracker;
+  if (!t)
+    return;
+  t->reuse = enable != 0;
+  if (!t->reuse)
+    memmgr_flush_cache(t);
+}
+
+int libraw_memmgr::get_reuse()
+{
+  return tracker && ((libraw_memmgr_tracker *)tracker)->reuse;
+}
+
+INT64 libraw_memmgr::bytes_requested()
+{
+  libraw_memmgr_tracker *t = (libraw_memmgr_tracker *)tracker;
+  if (!t)
+    return 0;
+  return t->requested;
+}
+
+void *libraw_memmgr::malloc(size_t sz)
+{
+  libraw_memmgr_tracker *t = (libraw_memmgr_tracker *)tracker;
+  if (!t)
+#ifdef LIBRAW_USE_CALLOC_INSTEAD_OF_MALLOC
+    return ::calloc(sz + extra_bytes, 1);
+#else
+    return ::malloc(sz + extra_bytes);
+#endif
+  size_t bsize = sz + extra_bytes;
+  memmgr_count(t, sz);
+  void *ptr = memmgr_reuse_get(t, bsize, &bsize);
+#ifdef LIBRAW_USE_CALLOC_INSTEAD_OF_MALLOC
+  if (ptr) // a reused block holds old data, malloc() promises zeroes here
+    memset(ptr, 0, sz + extra_bytes);
+#endif
+  if (!ptr)
+    ptr = memmgr_sys_malloc(t, bsize);
+  if (ptr)
+    memmgr_track(t, ptr, bsize);
+  return ptr;
+}
+
+void *libraw_memmgr::calloc(size_t n, size_t sz)
+{
+  libraw_memmgr_tracker *t = (libraw_memmgr_tracker *)tracker;
+  size_t cnt = n + (extra_bytes + sz - 1) / (sz ? sz : 1);
+  if (!t)
+    return ::calloc(cnt, sz);
+  size_t bsize = 0;
+  void *ptr = NULL;
+  if (!sz || cnt <= ~size_t(0) / sz)
+  {
+    bsize = cnt * sz;
+    memmgr_count(t, n * sz);
+    ptr = memmgr_reuse_get(t, bsize, &bsize);
+    if (ptr)
+      memset(ptr, 0, cnt * sz);
+  }
+  if (!ptr)
+  {
+    ptr = t->user_allocator ? t->allocator.calloc_func(t->allocator.data, cnt, sz)
+                            : ::calloc(cnt, sz);
+    bsize = cnt * sz;
+  }
+  if (ptr)
+    memmgr_track(t, ptr, bsize);
+  return ptr;
+}
+
+void *libraw_memmgr::realloc(void *ptr, size_t newsz)
+{
+  libraw_memmgr_tracker *t = (libraw_memmgr_tracker *)tracker;
+  if (!ptr)
+    return malloc(newsz);
+  if (!t)
+    return ::realloc(ptr, newsz + extra_bytes);
+  size_t oldsize;
+  memmgr_count(t, newsz);
+  if (!memmgr_untrack(t, ptr, &oldsize))
+  {
+    /* not ours: stays on the C runtime heap */
+    void *ret = ::realloc(ptr, newsz + extra_bytes);
+    if (ret && !t->user_allocator)
+      memmgr_track(t, ret, newsz + extra_bytes);
+    return ret;
+  }
+  void *ret = t->user_allocator
+                  ? t->allocator.realloc_func(t->allocator.data, ptr, newsz + extra_bytes)
+                  : ::realloc(ptr, newsz + extra_bytes);
+  if (ret)
+    memmgr_track(t, ret, newsz + extra_bytes);
+  else
+    memmgr_track(t, ptr, oldsize);
+  return ret;
+}
+
+void libraw_memmgr::free(void *ptr)
+{
+  libraw_memmgr_tracker *t = (libraw_memmgr_tracker *)tracker;
+  if (!ptr)
+    return;
+  size_t size;
+  if (t && memmgr_untrack(t, ptr, &size))
+    memmgr_release(t, ptr, size);
+  else
+    ::free(ptr);
+}
+
+void libraw_memmgr::cleanup(void)
+{
+  libraw_memmgr_tracker *t = (libraw_memmgr_tracker *)tracker;
+  if (!t)
+    return;
+  for (int n = 0; n < LIBRAW_MEMMGR_SHARDS; n++)
+  {
+    libraw_memmgr_shard &s = t->shard[n];
+    memmgr_lock(s);
+    for (size_t i = 0; i < s.cap && s.count; i++)
+      if (s.slots[i].ptr)
+      {
+        memmgr_release(t, s.slots[i].ptr, s.slots[i].size);
+        s.slots[i].ptr = NULL;
+        s.count--;
+      }
+    memmgr_unlock(s);
+  }
+}
+
 void *LibRaw::malloc(size_t t)
 {
   void *p = memmgr.malloc(t);
@@ -279,6 +717,56 @@ void *LibRaw::calloc(size_t n, size_t t)
 }
 void LibRaw::free(void *p) { memmgr.free(p); }
 
+void LibRaw::set_allocator(const libraw_allocator_t *allocator)
+{
+  recycle(); // no blocks from the previous allocator may stay
+  memmgr.set_allocator(allocator);
+}
+
+void LibRaw::set_arena_mode(int enable) { memmgr.set_reuse(enable); }
+
+void LibRaw::reset_perf_stats()
+{
+  ZERO(perf_stats);
+  perf_stage_begin();
+}
+
+void LibRaw::perf_snapshot(libraw_perf_stage_t &s)
+{
+  s.wall_time = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+  s.cpu_time = double(clock()) / CLOCKS_PER_SEC;
+  perf_stream = ID.input;
+  s.bytes_read = ID.input ? ID.input->bytes_read() : 0;
+  s.bytes_allocated = memmgr.bytes_requested();
+}
+
+void LibRaw::perf_stage_end(unsigned stage)
+{
+  int n = 0;
+  if (!stage)
+    return;
+  while (!(stage & (1U << n)))
+    n++;
+  libraw_perf_stage_t now;
+  /* a stream opened during the stage has counted from zero */
+  INT64 read0 = perf_stream == ID.input ? perf_mark.bytes_read : 0;
+  perf_snapshot(now);
+  libraw_perf_stage_t &st = perf_stats.stage[n];
+  st.wall_time += now.wall_time - perf_mark.wall_time;
+  st.cpu_time += now.cpu_time - perf_mark.cpu_time;
+  st.bytes_read += MAX(now.bytes_read - read0, 0);
+  st.bytes_allocated += now.bytes_allocated - perf_mark.bytes_allocated;
+#ifdef LIBRAW_USE_OPENMP
+  st.threads = MAX(st.threads, omp_get_max_threads());
+#else
+  st.threads = 1;
+#endif
+  st.calls++;
+  perf_mark = now;
+}
+
 void LibRaw::recycle_datastream()
 {
   if (libraw_internal_data.internal_data.input &&
@@ -345,10 +833,12 @@ int LibRaw::is_curve_linear()
 
 void LibRaw::free_image(void)
 {
-  if (imgdata.image)
+  if (imgdata.image || imgdata.rgb_image)
   {
     free(imgdata.image);
     imgdata.image = 0;
+    free(imgdata.rgb_image);
+    imgdata.rgb_image = 0;
     imgdata.progress_flags = LIBRAW_PROGRESS_START | LIBRAW_PROGRESS_OPEN |
                              LIBRAW_PROGRESS_IDENTIFY |
                              LIBRAW_PROGRESS_SIZE_ADJUST |
@@ -378,6 +868,8 @@ const char *LibRaw::strprogress(enum LibRaw_progress p)
     return "Adjusting size";
   case LIBRAW_PROGRESS_LOAD_RAW:
     return "Reading RAW data";
+  case LIBRAW_PROGRESS_RAW2_IMAGE:
+    return "Copying RAW data to image";
   case LIBRAW_PROGRESS_REMOVE_ZEROES:
     return "Clearing zero values";
   case LIBRAW_PROGRESS_BAD_PIXELS:
@@ -417,6 +909,7 @@ const char *LibRaw::strprogress(enum LibRaw_progress p)
 int LibRaw::adjust_sizes_info_only(void)
 {
   CHECK_ORDER_LOW(LIBRAW_PROGRESS_IDENTIFY);
+  perf_stage_begin();
 
   raw2image_start();
   if (O.use_fuji_rotate)
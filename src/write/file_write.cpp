@@ -221,6 +221,9 @@ void LibRaw::write_ppm_tiff()
              fprintf(ofp, "P%d\n%d %d\n%d\n", colors / 2 + 5, width, height,
             (1 << output_bps) - 1);
         }
+        // image[][4] or packed imgdata.rgb_image[][3]
+        const int ps = imgdata.rgb_image ? 3 : 4;
+        const ushort *src = imgdata.rgb_image ? imgdata.rgb_image[0] : image[0];
         soff = flip_index(0, 0);
         cstep = flip_index(0, 1) - soff;
         rstep = flip_index(1, 0) - flip_index(0, width);
@@ -228,9 +231,9 @@ void LibRaw::write_ppm_tiff()
         {
             for (col = 0; col < width; col++, soff += cstep)
                 if (output_bps == 8)
-                    FORCC ppm[col * colors + c] = curve[image[soff][c]] >> 8;
+                    FORCC ppm[col * colors + c] = curve[src[size_t(soff) * ps + c]] >> 8;
                 else
-                    FORCC ppm2[col * colors + c] = curve[image[soff][c]];
+                    FORCC ppm2[col * colors + c] = curve[src[size_t(soff) * ps + c]];
             if (output_bps == 16 && !output_tiff && htons(0x55aa) != 0x55aa)
                 libraw_swab(ppm2, width * colors * 2);
             fwrite(ppm.data(), colors * output_bps / 8, width, ofp);
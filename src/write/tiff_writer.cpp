@@ -22,8 +22,9 @@ int LibRaw::dcraw_ppm_tiff_writer(const char *filename)
 {
   CHECK_ORDER_LOW(LIBRAW_PROGRESS_LOAD_RAW);
 
-  if (!imgdata.image)
+  if (!imgdata.image && !imgdata.rgb_image)
     return LIBRAW_OUT_OF_ORDER_CALL;
+  perf_stage_begin();
 
   if (!filename)
     return ENOENT;
@@ -0,0 +1,253 @@
+/* -*- C++ -*-
+ * tests/test_cr3_downscale.cpp
+ *
+ * File-free check of the reduced-resolution CR3 decode
+ * (rawparams.cr3_downscale).
+ *
+ * Builds a synthetic 4-plane CRX stream (tile/plane/subband headers followed
+ * by pseudo-random coefficient data), runs crxSetupDownscale() on a set of
+ * sizes and margins, then decodes with crxLoadRaw() into a buffer of the
+ * resulting raw_width x raw_height surrounded by guard samples.
+ *
+ * For every shift it verifies:
+ *   - shift 0 leaves all sizes, margins and inset crops unchanged and the
+ *     decoder keeps the full-resolution path (reduceLevels == 0);
+ *   - shifts 1..3 give the raw size the decoder actually writes: every
+ *     sample of raw_width x raw_height is written, nothing outside it is;
+ *   - margins, visible size and inset crops are scaled and stay inside the
+ *     reduced raw frame;
+ *   - shift == levels (including a shift clamped to a 2-level image) takes
+ *     the LL-only branch of crxDecodeTile() and still covers the frame.
+ *
+ * Exit code 0 = pass, non-zero = a regression.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "libraw/libraw.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                       \
+  do                                                                           \
+  {                                                                            \
+    if (!(cond))                                                               \
+    {                                                                          \
+      failures++;                                                              \
+      printf("  [FAIL] ");                                                     \
+      printf(__VA_ARGS__);                                                     \
+      printf("\n");                                                            \
+    }                                                                          \
+  } while (0)
+
+static void put(std::vector<unsigned char> &v, unsigned x, int n)
+{
+  for (int i = n - 1; i >= 0; i--)
+    v.push_back((x >> (8 * i)) & 0xff);
+}
+
+static int reduced(int size, int shift) { return (size + (1 << shift) - 1) >> shift; }
+
+// reduced plane side, summed tile by tile
+static int reducedPlane(int planeSize, int tileSize, int shift)
+{
+  int sum = 0;
+  for (int pos = 0; pos < planeSize; pos += tileSize)
+    sum += reduced(planeSize - pos < tileSize ? planeSize - pos : tileSize, shift);
+  return sum;
+}
+
+static ushort reducedEven(ushort v, int shift) { return ((v >> 1) >> shift) << 1; }
+
+struct geometry_t
+{
+  int width, height, tileWidth, tileHeight, levels;
+  ushort left, top, right, bottom;
+};
+
+class CrxProbe : public LibRaw
+{
+public:
+  std::vector<unsigned char> stream;
+
+  // full-size CRX header plus a stream with one 3000 byte chunk per subband
+  void setup(const geometry_t &g)
+  {
+    int pW = g.width / 2, pH = g.height / 2, tW = g.tileWidth / 2, tH = g.tileHeight / 2;
+    int nTiles = ((pW + tW - 1) / tW) * ((pH + tH - 1) / tH);
+    int nBands = 3 * g.levels + 1, bandSize = 3000;
+
+    stream.clear();
+    for (int t = 0; t < nTiles; t++)
+    {
+      put(stream, 0xFF01, 2);
+      put(stream, 8, 2);
+      put(stream, 4 * nBands * bandSize, 4);
+      put(stream, t, 2);
+      put(stream, 0, 2);
+      for (int c = 0; c < 4; c++)
+      {
+        put(stream, 0xFF02, 2);
+        put(stream, 8, 2);
+        put(stream, nBands * bandSize, 4);
+        put(stream, c << 4, 1);
+        put(stream, 0, 3);
+        for (int b = 0; b < nBands; b++)
+        {
+          put(stream, 0xFF03, 2);
+          put(stream, 8, 2);
+          put(stream, bandSize, 4);
+          put(stream, (b << 28) | (4 << 19), 4);
+        }
+      }
+    }
+    int hdrSize = (int)stream.size();
+    // mostly alternating bits keep the adaptive Golomb codes short; plain
+    // random data runs into the decoder's error checks
+    unsigned seed = 12345;
+    for (int i = 0; i < nTiles * 4 * nBands * bandSize; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      stream.push_back(0xaa ^ ((seed >> 16) & 0x11));
+    }
+
+    crx_data_header_t &h = libraw_internal_data.unpacker_data.crx_header[0];
+    memset(&h, 0, sizeof(h));
+    h.version = 0x100;
+    h.f_width = g.width;
+    h.f_height = g.height;
+    h.tileWidth = g.tileWidth;
+    h.tileHeight = g.tileHeight;
+    h.nBits = 14;
+    h.nPlanes = 4;
+    h.imageLevels = g.levels;
+    h.mdatHdrSize = hdrSize;
+    h.medianBits = 14;
+    libraw_internal_data.unpacker_data.crx_track_selected = 0;
+    libraw_internal_data.unpacker_data.data_offset = 0;
+    libraw_internal_data.unpacker_data.data_size = stream.size();
+
+    sz.raw_width = g.width;
+    sz.raw_height = g.height;
+    sz.left_margin = g.left;
+    sz.top_margin = g.top;
+    sz.width = g.width - g.left - g.right;
+    sz.height = g.height - g.top - g.bottom;
+    sz.raw_inset_crops[0].cleft = g.left + 4;
+    sz.raw_inset_crops[0].ctop = g.top + 6;
+    sz.raw_inset_crops[0].cwidth = sz.width - 8;
+    sz.raw_inset_crops[0].cheight = sz.height - 12;
+    sz.raw_inset_crops[1].cleft = sz.raw_inset_crops[1].ctop = 0xffff;
+    sz.raw_inset_crops[1].cwidth = sz.raw_inset_crops[1].cheight = 0;
+  }
+
+  void downscale(unsigned shift)
+  {
+    imgdata.rawparams.cr3_downscale = shift;
+    crxSetupDownscale();
+  }
+
+  int reduceLevels() { return libraw_internal_data.unpacker_data.crx_header[0].reduceLevels; }
+
+  // decodes into raw_width x raw_height; returns 0 on success
+  int decode(ushort *out)
+  {
+    LibRaw_buffer_datastream ds(stream.data(), stream.size());
+    libraw_internal_data.internal_data.input = &ds;
+    imgdata.rawdata.raw_image = out;
+    int ret = 0;
+    try
+    {
+      crxLoadRaw();
+      ret = libraw_internal_data.unpacker_data.data_error;
+    }
+    catch (...)
+    {
+      ret = -1;
+    }
+    imgdata.rawdata.raw_image = 0;
+    libraw_internal_data.internal_data.input = 0;
+    return ret;
+  }
+
+  libraw_image_sizes_t &sz = imgdata.sizes;
+};
+
+static void check_geometry(const geometry_t &g, unsigned shift)
+{
+  CrxProbe *p = new CrxProbe;
+  p->setup(g);
+  libraw_image_sizes_t before = p->sz;
+  p->downscale(shift);
+  libraw_image_sizes_t &sz = p->sz;
+  int s = (int)shift < g.levels ? (int)shift : g.levels;
+
+  printf("%dx%d tile %dx%d levels %d shift %u -> %dx%d\n", g.width, g.height, g.tileWidth, g.tileHeight, g.levels,
+         shift, sz.raw_width, sz.raw_height);
+
+  CHECK(p->reduceLevels() == s, "reduceLevels %d, expected %d", p->reduceLevels(), s);
+  if (!s)
+  {
+    CHECK(!memcmp(&before, &sz, sizeof(sz)), "shift 0 changed the image sizes");
+  }
+  else
+  {
+    int rw = 2 * reducedPlane(g.width / 2, g.tileWidth / 2, s);
+    int rh = 2 * reducedPlane(g.height / 2, g.tileHeight / 2, s);
+    CHECK(sz.raw_width == rw && sz.raw_height == rh, "raw size %dx%d, expected %dx%d", sz.raw_width, sz.raw_height, rw,
+          rh);
+    CHECK(sz.left_margin == reducedEven(g.left, s) && sz.top_margin == reducedEven(g.top, s), "margins %d,%d",
+          sz.left_margin, sz.top_margin);
+    CHECK(sz.width == reducedEven(before.width, s) || sz.width == sz.raw_width - sz.left_margin, "width %d", sz.width);
+    CHECK(sz.height == reducedEven(before.height, s) || sz.height == sz.raw_height - sz.top_margin, "height %d",
+          sz.height);
+    const libraw_raw_inset_crop_t &c = sz.raw_inset_crops[0], &c0 = before.raw_inset_crops[0];
+    CHECK(c.cleft == reducedEven(c0.cleft, s) && c.ctop == reducedEven(c0.ctop, s) &&
+              c.cwidth == reducedEven(c0.cwidth, s) && c.cheight == reducedEven(c0.cheight, s),
+          "inset crop %d,%d %dx%d", c.cleft, c.ctop, c.cwidth, c.cheight);
+    CHECK(!memcmp(&sz.raw_inset_crops[1], &before.raw_inset_crops[1], sizeof(c)), "unset inset crop changed");
+  }
+  CHECK(sz.left_margin + sz.width <= sz.raw_width && sz.top_margin + sz.height <= sz.raw_height,
+        "visible area %d,%d %dx%d outside of %dx%d", sz.left_margin, sz.top_margin, sz.width, sz.height, sz.raw_width,
+        sz.raw_height);
+  CHECK(sz.raw_inset_crops[0].cleft + sz.raw_inset_crops[0].cwidth <= sz.raw_width &&
+            sz.raw_inset_crops[0].ctop + sz.raw_inset_crops[0].cheight <= sz.raw_height,
+        "inset crop outside of the raw frame");
+
+  // 14-bit output never reaches 0xffff: any such sample inside the frame
+  // was not written, any other value in the guard band was overwritten
+  const int guard = 4096;
+  size_t n = (size_t)sz.raw_width * sz.raw_height;
+  std::vector<ushort> buf(n + 2 * guard, 0xffff);
+  CHECK(p->decode(buf.data() + guard) == 0, "decoder error");
+  size_t unwritten = 0, overrun = 0;
+  for (size_t i = 0; i < buf.size(); i++)
+  {
+    bool inside = i >= (size_t)guard && i < n + guard;
+    if (inside && buf[i] == 0xffff)
+      unwritten++;
+    else if (!inside && buf[i] != 0xffff)
+      overrun++;
+  }
+  CHECK(!unwritten, "%zu samples of the %dx%d frame not written", unwritten, sz.raw_width, sz.raw_height);
+  CHECK(!overrun, "%zu samples written outside of the frame", overrun);
+  delete p;
+}
+
+int main(void)
+{
+  const geometry_t geometries[] = {
+      {500, 380, 192, 160, 3, 12, 8, 6, 10}, // 3x3 tiles, partial right/bottom tiles
+      {488, 340, 176, 176, 3, 64, 32, 0, 0}, // tile sides not a multiple of 8
+      {196, 152, 400, 400, 2, 6, 4, 2, 2},   // single tile, shift 3 clamps to 2
+  };
+
+  for (size_t i = 0; i < sizeof(geometries) / sizeof(geometries[0]); i++)
+    for (unsigned shift = 0; shift <= 3; shift++)
+      check_geometry(geometries[i], shift);
+
+  printf("\n%s\n", failures ? "FAILED" : "All CR3 downscale checks passed");
+  return failures ? 1 : 0;
+}
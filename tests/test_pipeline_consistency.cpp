@@ -15,6 +15,8 @@
  *                          (thread-local histogram merge, reduction(max),
  *                          per-pixel/per-row writes) contain no data race that
  *                          changes the result.
+ * It also checks that the packed RGB output layout (params.packed_rgb) gives
+ * byte-identical dcraw_make_mem_image() output.
  *
  * Exit code 0 = pass, non-zero = a regression.
  */
@@ -39,15 +41,29 @@ static unsigned long long fnv1a(const unsigned char *p, size_t n)
   return h;
 }
 
-// Decode the synthetic frame once at quality q; return FNV-1a of the 16-bit
-// processed image, or 0 on pipeline error (with *ok cleared).
+struct output_opts
+{
+  int packed, output_color, bps, flip, auto_bright;
+};
+
+// 16-bit sRGB, flip from file, histogram independent output
+static const output_opts default_opts = {0, 1, 16, -1, 0};
+
+// Decode the synthetic frame once at quality q (with FBDD noise reduction
+// level fbdd); return FNV-1a of the processed image, or 0 on pipeline
+// error (with *ok cleared).
 static unsigned long long decode(const ushort *bayer, int W, int H, int q,
-                                 int *ok)
+                                 int fbdd, int *ok,
+                                 const output_opts &o = default_opts)
 {
   LibRaw R;
   R.imgdata.params.user_qual = q;
-  R.imgdata.params.no_auto_bright = 1; // keep output independent of histogram
-  R.imgdata.params.output_bps = 16;
+  R.imgdata.params.fbdd_noiserd = fbdd;
+  R.imgdata.params.no_auto_bright = !o.auto_bright;
+  R.imgdata.params.output_bps = o.bps;
+  R.imgdata.params.output_color = o.output_color;
+  R.imgdata.params.user_flip = o.flip;
+  R.imgdata.params.packed_rgb = o.packed;
 
   size_t bytes = (size_t)W * H * sizeof(ushort);
   int ret = R.open_bayer((unsigned char *)bayer, (unsigned)bytes, W, H, 0, 0, 0,
@@ -100,55 +116,88 @@ int main(void)
   printf("OpenMP not enabled (serial build)\n");
 #endif
 
-  const int quals[] = {0, 3, 11}; // bilinear, AHD, DHT (all parallel paths)
+  // bilinear, VNG, AHD, DCB, DHT, AAHD, plus DCB after both FBDD levels
+  // (all parallel paths)
+  const int quals[][2] = {{0, 0}, {1, 0}, {3, 0}, {4, 0},
+                          {11, 0}, {12, 0}, {4, 1}, {4, 2}};
   int failures = 0;
 
   for (size_t i = 0; i < sizeof(quals) / sizeof(quals[0]); i++)
   {
-    int q = quals[i];
+    int q = quals[i][0], fbdd = quals[i][1];
     int ok = 1;
 
 #ifdef _OPENMP
     omp_set_num_threads(1);
 #endif
-    unsigned long long serial = decode(bayer, W, H, q, &ok);
+    unsigned long long serial = decode(bayer, W, H, q, fbdd, &ok);
 
 #ifdef _OPENMP
     omp_set_num_threads(maxthreads);
 #endif
-    unsigned long long par1 = decode(bayer, W, H, q, &ok);
-    unsigned long long par2 = decode(bayer, W, H, q, &ok); // determinism
+    unsigned long long par1 = decode(bayer, W, H, q, fbdd, &ok);
+    unsigned long long par2 = decode(bayer, W, H, q, fbdd, &ok); // determinism
 
     if (!ok)
     {
-      printf("[FAIL] q=%-2d pipeline error\n", q);
+      printf("[FAIL] q=%-2d fbdd=%d pipeline error\n", q, fbdd);
       failures++;
       continue;
     }
     if (par1 != par2)
     {
-      printf("[FAIL] q=%-2d non-deterministic: %016llx != %016llx\n", q, par1,
-             par2);
+      printf("[FAIL] q=%-2d fbdd=%d non-deterministic: %016llx != %016llx\n",
+             q, fbdd, par1, par2);
       failures++;
       continue;
     }
     if (serial != par1)
     {
-      printf("[FAIL] q=%-2d threaded output differs from 1-thread: "
+      printf("[FAIL] q=%-2d fbdd=%d threaded output differs from 1-thread: "
              "%016llx != %016llx (DATA RACE)\n",
-             q, par1, serial);
+             q, fbdd, par1, serial);
       failures++;
       continue;
     }
-    printf("[ OK ] q=%-2d deterministic & thread-invariant  checksum=%016llx\n",
-           q, par1);
+    printf("[ OK ] q=%-2d fbdd=%d deterministic & thread-invariant  "
+           "checksum=%016llx\n",
+           q, fbdd, par1);
+  }
+
+  // packed_rgb against image[][4] output: raw color, sRGB and ProPhoto,
+  // 8 and 16 bit, flips, auto brightness (uses the conversion histogram)
+  const output_opts packed_opts[] = {
+      {1, 0, 16, 0, 0}, {1, 1, 16, 0, 0}, {1, 1, 8, 0, 1},
+      {1, 4, 8, 5, 1},  {1, 1, 16, 3, 0}, {1, 1, 8, 6, 0}};
+  const int npacked = sizeof(packed_opts) / sizeof(packed_opts[0]);
+  int packed_failures = 0;
+  for (int i = 0; i < npacked; i++)
+  {
+    output_opts o = packed_opts[i];
+    int ok = 1;
+    unsigned long long packed = decode(bayer, W, H, 3, 0, &ok, o);
+    o.packed = 0;
+    unsigned long long plain = decode(bayer, W, H, 3, 0, &ok, o);
+    if (!ok || packed != plain)
+    {
+      printf("[FAIL] packed_rgb output_color=%d bps=%d flip=%d bright=%d: "
+             "%016llx != %016llx\n",
+             o.output_color, o.bps, o.flip, o.auto_bright, packed, plain);
+      packed_failures++;
+      continue;
+    }
+    printf("[ OK ] packed_rgb output_color=%d bps=%-2d flip=%d bright=%d "
+           "same output  checksum=%016llx\n",
+           o.output_color, o.bps, o.flip, o.auto_bright, packed);
   }
 
   free(bayer);
 
-  printf("\n%s (%d/%d quality modes passed)\n",
-         failures ? "PIPELINE CONSISTENCY TEST FAILED" : "ALL CHECKS PASSED",
+  printf("\n%s (%d/%d quality modes, %d/%d packed layouts passed)\n",
+         failures + packed_failures ? "PIPELINE CONSISTENCY TEST FAILED"
+                                    : "ALL CHECKS PASSED",
          (int)(sizeof(quals) / sizeof(quals[0])) - failures,
-         (int)(sizeof(quals) / sizeof(quals[0])));
-  return failures ? 1 : 0;
+         (int)(sizeof(quals) / sizeof(quals[0])), npacked - packed_failures,
+         npacked);
+  return failures + packed_failures ? 1 : 0;
 }